@@ -0,0 +1,313 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <chrono>
+#include "player.hpp"
+using namespace std;
+
+/*
+ * A fixed suite of benchmark positions, for measuring the engine's speed and
+ * catching regressions. Midgame positions are searched to a fixed depth, and
+ * count as correct if the move found is the one that a search two plies deeper
+ * found when the suite was made. A shallower search need not agree (at the
+ * suite's depths, mid20 and mid33 do not), so a midgame mismatch is reported
+ * as "differs" rather than as wrong. Endgame positions are solved exactly, and
+ * count as correct if the final disc difference is right (every expected score
+ * was checked against a separate, square-by-square solver).
+ *
+ * Usage: bench [--option=value ...] [results [baseline]]
+ *
+ * Each position is searched by a new engine (with a 64 MB table, unless --hash
+ * is given, and without the solved-position database), so that the positions
+ * do not affect each other; the fastest of several runs is timed. The results
+ * are printed, and also written to the results file, one tab-separated line per
+ * position followed by the totals:
+ *
+ *   name  depth  nodes  ms  move  score  correct
+ *
+ * where depth is 0 for a position that was solved, and correct is 1 or 0 (or,
+ * for the totals, the number of positions with correct results). If a baseline (a results
+ * file from an earlier run) is given, every position is compared against it,
+ * and the exit status is 1 if any position that was correct no longer is, or
+ * if the total number of nodes has grown by more than the tolerance below.
+ * The search is deterministic, so node counts are exact; times are not, and a
+ * total time past its tolerance is only warned about.
+ */
+
+// The allowed growth, in percent, of the total number of nodes and of the
+// total time over the baseline. Times vary much more from run to run.
+#define BENCH_NODE_TOLERANCE 2
+#define BENCH_TIME_TOLERANCE 15
+
+// The number of times each position is searched; only the fastest time counts.
+// In a profiling build, doMove() prints a breakdown of every search, so each
+// position is only searched once.
+#ifdef PROFILE
+#define BENCH_RUNS 1
+#else
+#define BENCH_RUNS 3
+#endif
+
+struct BenchPosition
+{
+    const char *name;
+
+    // The board, row by row from the top left: 'b', 'w', or '-' for empty.
+    const char *board;
+    Side side;
+
+    // The search depth, or 0 to solve the position exactly.
+    int depth;
+
+    // For midgame positions, the move found by a search two plies deeper; for
+    // endgame positions, the expected final disc difference for the side to
+    // move.
+    int expected_x, expected_y;
+    int32_t expected_score;
+};
+
+static const BenchPosition suite[] = {
+    {"mid20", "------------------b--w-----bbbw----bbww----bw-w--wwwww---b--w---",
+        BLACK, 7, 7, 4, 0},
+    {"mid25", "-----------w---b---w--b--wbbbbb-wwwbwww----wbw----w--bwb-------w",
+        WHITE, 8, 7, 5, 0},
+    {"mid28", "------------bb-w---bbbwb--bwbww---wwb-wb-wwwwwww-bb-----b-------",
+        BLACK, 8, 7, 3, 0},
+    {"mid33", "-b-------wbww-----wbw--w-wbwwbww-bbbwww---wwwww----w-w----www-b-",
+        WHITE, 7, 0, 3, 0},
+    {"mid36", "w-wb----wwbbb---wbwb--b-wwbwbb--ww-wwwb-w-wwwwwb---ww-b-----w---",
+        BLACK, 8, 7, 6, 0},
+    {"mid41", "bbbbbbwwbbbbbbwwbbbbwwbwb-wbwbbw--wwbwbw-----bbw------b---------",
+        WHITE, 7, 3, 5, 0},
+    {"end12a", "w--bbbb-bw--bw-wbbwbbbww-bbwbwww-bbbwwwwwwwbwwwwbwwwbww-b-wb-w-w",
+        BLACK, 0, 0, 0, 16},
+    {"end12b", "b--bw--wwwwww-w-wwbbwb---bwwwbbwbbwwwbbbbbbbwwb-bwwwwwwbb-www-ww",
+        BLACK, 0, 0, 0, 20},
+    {"end14a", "bwwwww--bww-w-wwbwbwbwbwwwwbbbww-w-bbbbwwwwb-bb--w-w--wbbw--wbbb",
+        BLACK, 0, 0, 0, 40},
+    {"end14b", "wb-b--w-wwbb-bwwwbwbbbwww-bwbwww--bbwbww---bwwww--bbb-ww--wbbbww",
+        BLACK, 0, 0, 0, -26},
+    {"end14c", "---w-bw-wwwwwwbbwwwwwbb-wwwbbbw-wwwbbwwwwbbww-w--w-bwwwbw-wb-ww-",
+        BLACK, 0, 0, 0, 34},
+    {"end16a", "--wwwww--bbbbwww--bbbww---bbwwww-bbbbbwbb-wwwwwwwbwwwwww--b-wwww",
+        BLACK, 0, 0, 0, -6},
+    {"end16b", "wb-wwww-wbwbbww-wwbbwb-wwwwwbbb-bwwwbbbbwbwwwwbb-w---wwb--w-----",
+        BLACK, 0, 0, 0, 22},
+    {"end16c", "---w-bw-wwwwww-bwwwwwwb-wwwbwbw-wwbwbwwwwbbbw-w--w-bbwwbw-wb--w-",
+        BLACK, 0, 0, 0, 32}
+};
+
+struct BenchResult
+{
+    int depth;
+    uint64_t nodes;
+    double ms;
+    string move;
+    int32_t score;
+
+    // 1 if the result is correct and 0 if not, or, for the totals, the number
+    // of positions with correct results.
+    int correct;
+};
+
+// Searches or solves one position with a new engine.
+static BenchResult run_position(
+    const BenchPosition &position, EngineOptions options
+    )
+{
+    char board_data[64];
+    for (int i = 0; i < 64; i++)
+        board_data[i] = position.board[i];
+
+    int num_empties = 0;
+    for (int i = 0; i < 64; i++)
+        num_empties += (position.board[i] == '-');
+
+    options.max_depth = position.depth ? position.depth : 1;
+    options.endgame_empties = position.depth ? 0 : num_empties;
+
+    Engine *engine = new Engine(options);
+    Player *player = new Player(position.side, engine);
+    set_board(board_data, player->get_board());
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    Move *move = player->doMove(nullptr, -1);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+    BenchResult result;
+    result.depth = position.depth;
+    result.nodes = player->get_nodes();
+    result.ms = chrono::duration<double, milli>(end - start).count();
+    result.score = player->get_score();
+
+    ostringstream move_name;
+    move_name << move->x << "," << move->y;
+    result.move = move_name.str();
+
+    result.correct = position.depth ?
+    (move->x == position.expected_x && move->y == position.expected_y) :
+    (result.score == position.expected_score);
+
+    delete move;
+    delete player;
+    delete engine;
+    return result;
+}
+
+// Reads a results file into a map from position names (and "total") to
+// results, returning false if it cannot be read.
+static bool read_results(const char *path, map<string, BenchResult> &results)
+{
+    ifstream file(path);
+    if (!file)
+        return false;
+
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        istringstream fields(line);
+        string name;
+        BenchResult result;
+
+        if (
+            fields >> name >> result.depth >> result.nodes >> result.ms >>
+            result.move >> result.score >> result.correct
+            )
+            results[name] = result;
+    }
+
+    return true;
+}
+
+static void write_result(
+    ostream &out, const string &name, const BenchResult &result
+    )
+{
+    out << name << "\t" << result.depth << "\t" << result.nodes << "\t" <<
+    fixed << setprecision(1) << result.ms << "\t" << result.move << "\t" <<
+    result.score << "\t" << result.correct << endl;
+}
+
+// Returns the change from old_value to new_value, in percent.
+static double percent_change(double old_value, double new_value)
+{
+    return old_value ? 100 * (new_value - old_value) / old_value : 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Read in engine options, followed by the optional results and baseline
+    // files.
+    EngineOptions options;
+    options.hash_mb = 64;
+
+    int num_positional = options.parse_args(argc - 1, argv + 1);
+    if (num_positional < 0 || num_positional > 2) {
+        cerr << "usage: " << argv[0] <<
+        " [--option=value ...] [results [baseline]]" << endl;
+        exit(-1);
+    }
+
+    // The database would let later runs skip work that earlier runs did.
+    options.solvedb_file = "";
+
+    map<string, BenchResult> baseline;
+    if (num_positional == 2 && !read_results(argv[2], baseline)) {
+        cerr << "could not read " << argv[2] << endl;
+        exit(-1);
+    }
+
+    ostringstream results;
+    results << "# name\tdepth\tnodes\tms\tmove\tscore\tcorrect" << endl;
+
+    BenchResult total = {0, 0, 0, "-", 0, 0};
+    bool regressed = false;
+
+    cout << left << setw(8) << "name" << right << setw(6) << "depth" <<
+    setw(12) << "nodes" << setw(10) << "ms" << setw(10) << "knps" <<
+    setw(7) << "move" << setw(8) << "score" << "  result" << endl;
+
+    for (size_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++)
+    {
+        BenchResult result = run_position(suite[i], options);
+        for (int run = 1; run < BENCH_RUNS; run++)
+        {
+            BenchResult rerun = run_position(suite[i], options);
+            if (rerun.ms < result.ms)
+                result.ms = rerun.ms;
+        }
+
+        total.nodes += result.nodes;
+        total.ms += result.ms;
+        total.correct += result.correct;
+
+        write_result(results, suite[i].name, result);
+
+        cout << left << setw(8) << suite[i].name << right << setw(6) <<
+        (result.depth ? to_string(result.depth) : string("solve")) <<
+        setw(12) << result.nodes << setw(10) << fixed << setprecision(1) <<
+        result.ms << setw(10) << setprecision(0) <<
+        result.nodes / result.ms << setw(7) << result.move << setw(8) <<
+        result.score << "  " <<
+        (result.correct ? "ok" : result.depth ? "differs" : "WRONG");
+
+        map<string, BenchResult>::iterator old = baseline.find(suite[i].name);
+        if (old != baseline.end())
+        {
+            cout << showpos << setprecision(1) << "  nodes " <<
+            percent_change(old->second.nodes, result.nodes) << "%  time " <<
+            percent_change(old->second.ms, result.ms) << "%" << noshowpos;
+
+            if (old->second.move != result.move)
+                cout << "  (was " << old->second.move << ")";
+
+            if (old->second.correct && !result.correct)
+            {
+                cout << "  REGRESSION";
+                regressed = true;
+            }
+        }
+
+        cout << endl;
+    }
+
+    write_result(results, "total", total);
+
+    cout << left << setw(8) << "total" << right << setw(6) << "" <<
+    setw(12) << total.nodes << setw(10) << fixed << setprecision(1) <<
+    total.ms << setw(10) << setprecision(0) << total.nodes / total.ms <<
+    setw(15) << "" << "  " << total.correct << "/" <<
+    sizeof(suite) / sizeof(suite[0]) << " correct" << endl;
+
+    map<string, BenchResult>::iterator old = baseline.find("total");
+    if (old != baseline.end())
+    {
+        double node_change = percent_change(old->second.nodes, total.nodes),
+        time_change = percent_change(old->second.ms, total.ms);
+
+        cout << showpos << setprecision(1) << "against baseline: nodes " <<
+        node_change << "%, time " << time_change << "%" << noshowpos << endl;
+
+        if (node_change > BENCH_NODE_TOLERANCE)
+            regressed = true;
+
+        if (time_change > BENCH_TIME_TOLERANCE)
+            cout << "warning: the total time grew past its tolerance (not " <<
+            "counted as a regression, since times are noisy)" << endl;
+    }
+
+    if (num_positional >= 1) {
+        ofstream file(argv[1]);
+        file << results.str();
+    }
+
+    if (regressed)
+        cout << "REGRESSION" << endl;
+
+    return regressed;
+}
@@ -1,4 +1,5 @@
 #include "board.hpp"
+#include "profile.hpp"
 
 // An array for finding the index of the least significant bit in a 64-bit
 // integer using the DeBruijn sequence 0x03f79d71b4cb0a89. Obtained from
@@ -100,6 +101,7 @@ void set_bits(Board board, uint64_t whites, uint64_t blacks)
 {
     board->bits[WHITE] = whites;
     board->bits[BLACK] = blacks;
+    board->odd_squares = odd_regions(~(whites | blacks));
 
     board->hash = 0;
     uint64_t stone = 1ULL;
@@ -116,6 +118,66 @@ void set_bits(Board board, uint64_t whites, uint64_t blacks)
     }
 }
 
+// Reflects the bitboard across the horizontal axis (swaps rows 0 and 7, etc.).
+inline uint64_t flip_vertical(uint64_t x)
+{
+    return __builtin_bswap64(x);
+}
+
+// Reflects the bitboard across the vertical axis (swaps columns 0 and 7, etc.).
+inline uint64_t flip_horizontal(uint64_t x)
+{
+    x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+    x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+    return ((x >> 4) & 0x0F0F0F0F0F0F0F0F) | ((x & 0x0F0F0F0F0F0F0F0F) << 4);
+}
+
+// Reflects the bitboard across the main diagonal (swaps x and y). Obtained from
+// http://chessprogramming.wikispaces.com/Flipping+Mirroring+and+Rotating.
+inline uint64_t flip_diagonal(uint64_t x)
+{
+    uint64_t t;
+    t  = 0x0F0F0F0F00000000 & (x ^ (x << 28));
+    x ^= t ^ (t >> 28);
+    t  = 0x3333000033330000 & (x ^ (x << 14));
+    x ^= t ^ (t >> 14);
+    t  = 0x5500550055005500 & (x ^ (x <<  7));
+    x ^= t ^ (t >>  7);
+    return x;
+}
+
+void canonical_bits(uint64_t *a, uint64_t *b)
+{
+    uint64_t sym_a[8], sym_b[8];
+
+    sym_a[0] = *a;
+    sym_b[0] = *b;
+    sym_a[1] = flip_horizontal(*a);
+    sym_b[1] = flip_horizontal(*b);
+
+    // Every symmetry of the square is some combination of a horizontal,
+    // vertical, and diagonal reflection.
+    for (int i = 0; i < 2; i++)
+    {
+        sym_a[i + 2] = flip_vertical(sym_a[i]);
+        sym_b[i + 2] = flip_vertical(sym_b[i]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        sym_a[i + 4] = flip_diagonal(sym_a[i]);
+        sym_b[i + 4] = flip_diagonal(sym_b[i]);
+    }
+
+    for (int i = 1; i < 8; i++)
+    {
+        if (sym_a[i] < *a || (sym_a[i] == *a && sym_b[i] < *b))
+        {
+            *a = sym_a[i];
+            *b = sym_b[i];
+        }
+    }
+}
+
 
 // <--------------------------------------------------------------------------->
 
@@ -214,6 +276,8 @@ inline uint64_t all_flips(
     uint64_t this_side, uint64_t other_side, uint64_t stone
     )
 {
+    PROFILE_COUNT(PROFILE_ALL_FLIPS);
+
     /*
      * Any stones that lie on the left edge should not be moved to the left, and
      * any stones that lie on the right edge should not be moved to the right.
@@ -250,12 +314,19 @@ inline uint64_t all_flips(
 
 void add_stone(Board board, Side side, uint64_t stone)
 {
+    PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+
     uint64_t flipped_stones =
     all_flips(board->bits[side], board->bits[!side], stone);
 
+    board->odd_squares = odd_regions_after(
+        board->odd_squares, ~(board->bits[WHITE] | board->bits[BLACK]), stone
+        );
     board->bits[side] |= stone | flipped_stones;
     board->bits[!side] &= ~flipped_stones;
 
+    PROFILE_SCOPE(PROFILE_HASHING);
+
     board->hash ^= get_hash(stone, side) ^ get_hash(stone, EMPTY);
 
     do
@@ -264,14 +335,17 @@ void add_stone(Board board, Side side, uint64_t stone)
     while ((flipped_stones &= flipped_stones - 1));
 }
 
-void add_stone_copy(Board board, Side side, uint64_t stone)
+// Stores the copy of the board with the given stone added in board + 1, given
+// the stones that the new stone flips.
+static inline void copy_with_flips(
+    Board board, Side side, uint64_t stone, uint64_t flipped_stones
+    )
 {
-    uint64_t flipped_stones =
-    all_flips(board->bits[side], board->bits[!side], stone);
-
     (board + 1)->bits[side] = board->bits[side] | stone | flipped_stones;
     (board + 1)->bits[!side] = board->bits[!side] & ~flipped_stones;
 
+    PROFILE_SCOPE(PROFILE_HASHING);
+
     (board + 1)->hash =
     board->hash ^ get_hash(stone, side) ^ get_hash(stone, EMPTY);
 
@@ -281,6 +355,63 @@ void add_stone_copy(Board board, Side side, uint64_t stone)
     while ((flipped_stones &= flipped_stones - 1));
 }
 
+void add_stone_copy(Board board, Side side, uint64_t stone)
+{
+    PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+
+    copy_with_flips(
+        board, side, stone,
+        all_flips(board->bits[side], board->bits[!side], stone)
+        );
+}
+
+void add_stone_copy(
+    Board board, Side side, uint64_t stone, uint64_t flipped_stones
+    )
+{
+    PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+
+    copy_with_flips(board, side, stone, flipped_stones);
+}
+
+// Returns the hash of the board with the given stone added, given the stones
+// that the new stone flips.
+static inline uint64_t hash_with_flips(
+    Board board, Side side, uint64_t stone, uint64_t flipped_stones
+    )
+{
+    PROFILE_SCOPE(PROFILE_HASHING);
+
+    uint64_t hash =
+    board->hash ^ get_hash(stone, side) ^ get_hash(stone, EMPTY);
+
+    do
+        hash ^=
+        get_hash(flipped_stones, side) ^ get_hash(flipped_stones, !side);
+    while ((flipped_stones &= flipped_stones - 1));
+
+    return hash;
+}
+
+uint64_t child_hash(Board board, Side side, uint64_t stone)
+{
+    PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+
+    return hash_with_flips(
+        board, side, stone,
+        all_flips(board->bits[side], board->bits[!side], stone)
+        );
+}
+
+uint64_t child_hash(
+    Board board, Side side, uint64_t stone, uint64_t flipped_stones
+    )
+{
+    PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+
+    return hash_with_flips(board, side, stone, flipped_stones);
+}
+
 
 // <--------------------------------------------------------------------------->
 
@@ -363,76 +494,308 @@ uint64_t move_bitboard(uint64_t this_side_stones, uint64_t other_side_stones)
     return all_moves(this_side_stones, other_side_stones);
 }
 
-uint8_t num_safe(
-    uint64_t this_side_stones, uint64_t other_side_stones,
-    uint64_t other_side_moves
+uint64_t flip_bitboard(
+    uint64_t this_side_stones, uint64_t other_side_stones, uint64_t stone
+    )
+{
+    return all_flips(this_side_stones, other_side_stones, stone);
+}
+
+// Finds the other side's stones that can be reached from the given stones by
+// moving downward by shift_amount, one or more times, without leaving the other
+// side's stones. The direction must be "downward", as for downward_moves().
+inline uint64_t downward_fill(
+    uint64_t stones, uint64_t other_side, uint8_t shift_amount
+    )
+{
+    stones = (stones << shift_amount) & other_side;
+
+    stones |= (stones << shift_amount) & other_side;
+    stones |= (stones << shift_amount) & other_side;
+    stones |= (stones << shift_amount) & other_side;
+    stones |= (stones << shift_amount) & other_side;
+    stones |= (stones << shift_amount) & other_side;
+
+    return stones;
+}
+
+// Identical to downward_fill(), but for the "upward" directions.
+inline uint64_t upward_fill(
+    uint64_t stones, uint64_t other_side, uint8_t shift_amount
     )
 {
-    uint64_t flipped_stones = 0;
+    stones = (stones >> shift_amount) & other_side;
+
+    stones |= (stones >> shift_amount) & other_side;
+    stones |= (stones >> shift_amount) & other_side;
+    stones |= (stones >> shift_amount) & other_side;
+    stones |= (stones >> shift_amount) & other_side;
+    stones |= (stones >> shift_amount) & other_side;
+
+    return stones;
+}
+
+uint8_t num_safe(uint64_t this_side_stones, uint64_t other_side_stones)
+{
+    /*
+     * One of this side's stones can be flipped in some direction if and only
+     * if it lies on a line of this side's stones that has an empty square at
+     * one end and one of the other side's stones at the other end (the empty
+     * square is then one of the other side's moves). So, rather than finding
+     * the flips of each of the other side's moves, look for such lines in
+     * every direction at once, by filling from the empty squares in one
+     * direction and from the other side's stones in the opposite direction.
+     *
+     * A stone in the leftmost or rightmost column can only be flipped
+     * vertically, and leaving those stones out of the fills in every other
+     * direction also keeps the fills from wrapping around the board's edges.
+     */
+
+    uint64_t empty_spaces = ~(this_side_stones | other_side_stones),
+    inner = this_side_stones & R_EDGE & L_EDGE,
+    other = other_side_stones;
+
+    uint64_t flippable_stones =
+    // right and left
+    (downward_fill(empty_spaces, inner, 1) & upward_fill(other, inner, 1)) |
+    (upward_fill(empty_spaces, inner, 1) & downward_fill(other, inner, 1)) |
+    // down-left and up-right
+    (downward_fill(empty_spaces, inner, 7) & upward_fill(other, inner, 7)) |
+    (upward_fill(empty_spaces, inner, 7) & downward_fill(other, inner, 7)) |
+    // down and up
+    (downward_fill(empty_spaces, this_side_stones, 8) &
+    upward_fill(other, this_side_stones, 8)) |
+    (upward_fill(empty_spaces, this_side_stones, 8) &
+    downward_fill(other, this_side_stones, 8)) |
+    // down-right and up-left
+    (downward_fill(empty_spaces, inner, 9) & upward_fill(other, inner, 9)) |
+    (upward_fill(empty_spaces, inner, 9) & downward_fill(other, inner, 9));
+
+    return num_ones(this_side_stones & ~flippable_stones);
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+// Returns the given squares along with every square next to one of them.
+static inline uint64_t grow(uint64_t squares)
+{
+    // The left and right shifts are masked so that they do not wrap around the
+    // board's edges.
+    uint64_t row = squares | ((squares << 1) & L_EDGE) |
+    ((squares >> 1) & R_EDGE);
+
+    return row | (row << 8) | (row >> 8);
+}
+
+// Returns the region of empty squares that contains the given stone.
+static inline uint64_t fill_region(uint64_t stone, uint64_t empty_spaces)
+{
+    uint64_t region = stone, previous;
 
     do
-        flipped_stones |= all_flips(
-            other_side_stones, this_side_stones,
-            other_side_moves & -other_side_moves
-            );  // get all stones flipped after last move in other_side_moves
-    while ((other_side_moves &= other_side_moves - 1));
+    {
+        previous = region;
+        region = grow(region) & empty_spaces;
+    } while (region != previous);
 
-    return num_ones(this_side_stones & ~flipped_stones);
+    return region;
+}
+
+uint64_t odd_regions(uint64_t empty_spaces)
+{
+    PROFILE_SCOPE(PROFILE_PARITY);
+
+    if (num_ones(empty_spaces) > PARITY_MAX_EMPTIES)
+        return 0;
+
+    uint64_t odd_squares = 0;
+
+    while (empty_spaces)
+    {
+        uint64_t region = fill_region(empty_spaces & -empty_spaces, empty_spaces);
+
+        if (num_ones(region) & 1)
+            odd_squares |= region;
+
+        empty_spaces &= ~region;
+    }
+
+    return odd_squares;
+}
+
+uint64_t odd_regions_after(
+    uint64_t odd_squares, uint64_t empty_spaces, uint64_t stone
+    )
+{
+    PROFILE_SCOPE(PROFILE_PARITY);
+
+    empty_spaces &= ~stone;
+
+    uint8_t num_empties = num_ones(empty_spaces);
+    if (num_empties > PARITY_MAX_EMPTIES)
+        return 0;
+
+    // Regions were not tracked before this move.
+    if (num_empties == PARITY_MAX_EMPTIES)
+        return odd_regions(empty_spaces);
+
+    // Only the stone's region changes, and what is left of it is made up of
+    // the regions of the empty squares next to the stone (usually just one).
+    uint64_t neighbors = grow(stone) & empty_spaces;
+    odd_squares &= ~stone;
+
+    while (neighbors)
+    {
+        uint64_t region = fill_region(neighbors & -neighbors, empty_spaces);
+
+        if (num_ones(region) & 1)
+            odd_squares |= region;
+        else
+            odd_squares &= ~region;
+
+        neighbors &= ~region;
+    }
+
+    return odd_squares;
 }
 
 
 // <--------------------------------------------------------------------------->
 
 
-TableEntry get_entry(Board board, TableEntry table, size_t table_size)
+TableEntry get_entry(
+    Board board, TableEntry table, size_t table_size, EntryPool pool
+    )
 {
+    PROFILE_SCOPE(PROFILE_TABLE);
+
     // Since table_size is a power of 2, hash % table_size is equivalent to
     // hash & (table_size - 1).
     TableEntry entry = table + (board->hash & (table_size - 1));
 
     if (!entry->in_use)
     {
-        entry->board = board;
+        entry->bits[WHITE] = board->bits[WHITE];
+        entry->bits[BLACK] = board->bits[BLACK];
         return entry;
     }
 
     if (
-        board->bits[WHITE] == entry->board->bits[WHITE] &&
-        board->bits[BLACK] == entry->board->bits[BLACK]
+        board->bits[WHITE] == entry->bits[WHITE] &&
+        board->bits[BLACK] == entry->bits[BLACK]
         )
         return entry;
 
     // Deal with hash collisions using a linked list: every time a new collision
     // is detected, add a new entry containing the board that caused the
     // collision to the tail of the list.
+    //
+    // Several threads may share the table, so the tail is extended with an
+    // atomic compare-and-swap; if another thread extends it first, keep
+    // walking the list from there. The entries' other fields are read and
+    // written without synchronization, which at worst gives a thread a stale
+    // score or move ordering (moves from the table are only used to reorder
+    // legal moves).
+    //
+    // New entries come from the pool. An entry taken by a thread that then
+    // loses the race to extend the list is kept for its next try, and is only
+    // wasted if the board turns out to be in the list after all.
+    TableEntry next, new_entry = nullptr;
+
     do
     {
-        if (entry->next == nullptr)
-            return (entry->next = new struct table_entry_struct(board));
+        next = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE);
+
+        if (next == nullptr)
+        {
+            if (
+                !new_entry &&
+                __atomic_load_n(&pool->num_used, __ATOMIC_RELAXED) <
+                pool->size
+                )
+            {
+                size_t i = __atomic_fetch_add(
+                    &pool->num_used, 1, __ATOMIC_RELAXED
+                    );
+                if (i < pool->size)
+                    new_entry = pool->entries + i;
+            }
+
+            // Once the pool is empty, the chains stop growing, and a board
+            // that is not in its chain replaces the last entry of the chain
+            // (which was the most recently added one).
+            if (!new_entry)
+            {
+                entry->in_use = false;
+                entry->bits[WHITE] = board->bits[WHITE];
+                entry->bits[BLACK] = board->bits[BLACK];
+                return entry;
+            }
+
+            new_entry->bits[WHITE] = board->bits[WHITE];
+            new_entry->bits[BLACK] = board->bits[BLACK];
+
+            if (__atomic_compare_exchange_n(
+                &entry->next, &next, new_entry, false,
+                __ATOMIC_RELEASE, __ATOMIC_ACQUIRE
+                ))
+                return new_entry;
+        }
 
-        entry = entry->next;
+        // Start loading the entry after the next one while the next one is
+        // being compared.
+        entry = next;
+        if (entry->next)
+            __builtin_prefetch(entry->next);
     } while (
-        board->bits[WHITE] != entry->board->bits[WHITE] ||
-        board->bits[BLACK] != entry->board->bits[BLACK]
+        board->bits[WHITE] != entry->bits[WHITE] ||
+        board->bits[BLACK] != entry->bits[BLACK]
         );
 
     return entry;
 }
 
+TableEntry find_entry(Board board, TableEntry table, size_t table_size)
+{
+    PROFILE_SCOPE(PROFILE_TABLE);
+
+    TableEntry entry = table + (board->hash & (table_size - 1));
+
+    do
+        if (
+            board->bits[WHITE] == entry->bits[WHITE] &&
+            board->bits[BLACK] == entry->bits[BLACK]
+            )
+            return entry;
+    while ((entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE)));
+
+    return nullptr;
+}
+
 
 // <--------------------------------------------------------------------------->
 
 
 void get_moves(Board board, Side side, Movelist movelist)
 {
-    uint64_t moves = all_moves(board->bits[side], board->bits[!side]);
+    PROFILE_SCOPE(PROFILE_MOVEGEN);
+
+    uint64_t this_side = board->bits[side], other_side = board->bits[!side],
+    moves = all_moves(this_side, other_side);
 
     if (moves)
     {
         uint64_t *movepointer = movelist->moves;
 
         do
-            *movepointer++ = moves & -moves; // get last 1 in the move bitboard
+        {
+            *movepointer = moves & -moves; // get last 1 in the move bitboard
+            movelist->flips[movepointer - movelist->moves] =
+            all_flips(this_side, other_side, *movepointer);
+            movepointer++;
+        }
         while ((moves &= moves - 1)); // set last 1 in the move bitboard to a 0
 
         movelist->num_moves = movepointer - movelist->moves;
@@ -442,48 +805,112 @@ void get_moves(Board board, Side side, Movelist movelist)
         movelist->num_moves = 0;
 }
 
+// Moves the move at index i in the movelist to index j, along with its flipped
+// stones, and the move at index j to index i.
+static inline void swap_moves(Movelist movelist, size_t i, size_t j)
+{
+    uint64_t move = movelist->moves[i], flips = movelist->flips[i];
+
+    movelist->moves[i] = movelist->moves[j];
+    movelist->flips[i] = movelist->flips[j];
+    movelist->moves[j] = move;
+    movelist->flips[j] = flips;
+}
+
 void sort_moves(Movelist movelist, TableEntry entry)
 {
+    PROFILE_SCOPE(PROFILE_ORDERING);
+
     for (size_t i = 0; i < movelist->num_moves; i++)
     {
         if (movelist->moves[i] == entry->best_move)
         {
-            movelist->moves[i] = movelist->moves[0];
-            movelist->moves[0] = entry->best_move;
+            swap_moves(movelist, i, 0);
             break;
         }
         else if (movelist->moves[i] == entry->second_best_move)
         {
-            movelist->moves[i] = movelist->moves[1];
-            movelist->moves[1] = entry->second_best_move;
+            swap_moves(movelist, i, 1);
             break;
         }
         else if (movelist->moves[i] == entry->third_best_move)
         {
-            movelist->moves[i] = movelist->moves[2];
-            movelist->moves[2] = entry->third_best_move;
+            swap_moves(movelist, i, 2);
             break;
         }
     }
 }
 
+void move_to_front(Movelist movelist, uint64_t move)
+{
+    for (size_t i = 0; i < movelist->num_moves; i++)
+        if (movelist->moves[i] == move)
+        {
+            uint64_t flips = movelist->flips[i];
+
+            for (; i > 0; i--)
+            {
+                movelist->moves[i] = movelist->moves[i - 1];
+                movelist->flips[i] = movelist->flips[i - 1];
+            }
+
+            movelist->moves[0] = move;
+            movelist->flips[0] = flips;
+            return;
+        }
+}
+
+void sort_moves_fastest_first(Board board, Side side, Movelist movelist)
+{
+    PROFILE_SCOPE(PROFILE_ORDERING);
+
+    uint64_t this_side = board->bits[side], other_side = board->bits[!side];
+    uint8_t num_replies[32];
+
+    // Insertion sort, which keeps moves with the same number of replies in
+    // their original order. Among moves with the same number of replies, the
+    // moves into odd regions come first (the count is doubled to make room).
+    for (size_t i = 0; i < movelist->num_moves; i++)
+    {
+        uint64_t move = movelist->moves[i],
+        flipped_stones = movelist->flips[i];
+
+        uint8_t replies = 2 * num_ones(all_moves(
+            other_side & ~flipped_stones, this_side | move | flipped_stones
+            )) + !(move & board->odd_squares);
+
+        size_t j = i;
+        for (; j > 0 && num_replies[j - 1] > replies; j--)
+        {
+            num_replies[j] = num_replies[j - 1];
+            movelist->moves[j] = movelist->moves[j - 1];
+            movelist->flips[j] = movelist->flips[j - 1];
+        }
+
+        num_replies[j] = replies;
+        movelist->moves[j] = move;
+        movelist->flips[j] = flipped_stones;
+    }
+}
+
 
 // <--------------------------------------------------------------------------->
 
 
 void set_board(char *data, Board board)
 {
-    board->bits[WHITE] = 0;
-    board->bits[BLACK] = 0;
+    uint64_t whites = 0, blacks = 0;
 
     for (int i = 0; i < 64; i++)
     {
         if (data[i] == 'w')
-            board->bits[WHITE] |= new_stone(i % 8, i / 8);
+            whites |= new_stone(i % 8, i / 8);
 
         else if (data[i] == 'b')
-            board->bits[BLACK] |= new_stone(i % 8, i / 8);
+            blacks |= new_stone(i % 8, i / 8);
     }
+
+    set_bits(board, whites, blacks);
 }
 
 void print_board(Board board)
@@ -37,6 +37,12 @@ typedef struct board_struct
 {
     uint64_t bits[2];
     uint64_t hash;
+
+    // The empty squares in odd regions (see odd_regions()). set_bits() and
+    // add_stone() keep this up to date, but add_stone_copy() does not, since
+    // most copies are only looked at briefly; the searches update the copies
+    // that they search with update_odd_squares().
+    uint64_t odd_squares;
 } *Board;
 
 /*
@@ -97,6 +103,11 @@ void set_bits(Board board, uint64_t whites, uint64_t blacks);
 // Returns a 64-bit integer which represents a stone at the given position.
 #define new_stone(x, y) (1ULL << (8 * (y) + (x)))
 
+// Replaces the two bitboards with the smallest pair (compared first by a, then
+// by b) among their 8 rotations and reflections, so that symmetric positions
+// share a single representation.
+void canonical_bits(uint64_t *a, uint64_t *b);
+
 
 // <--------------------------------------------------------------------------->
 
@@ -125,6 +136,21 @@ void add_stone(Board board, Side side, uint64_t stone);
 // updating the hash appropriately. Stores the copy in the location board + 1.
 void add_stone_copy(Board board, Side side, uint64_t stone);
 
+// The same, for a stone whose flipped stones are already known (e.g. from a
+// movelist).
+void add_stone_copy(
+    Board board, Side side, uint64_t stone, uint64_t flipped_stones
+    );
+
+// Returns the hash that the board would have after the given stone belonging to
+// the specified side was added to it, without modifying the board.
+uint64_t child_hash(Board board, Side side, uint64_t stone);
+
+// The same, for a stone whose flipped stones are already known.
+uint64_t child_hash(
+    Board board, Side side, uint64_t stone, uint64_t flipped_stones
+    );
+
 
 // <--------------------------------------------------------------------------->
 
@@ -132,33 +158,111 @@ void add_stone_copy(Board board, Side side, uint64_t stone);
 // Returns a bitboard containing all the moves available to this side.
 uint64_t move_bitboard(uint64_t this_side_stones, uint64_t other_side_stones);
 
+// Returns a bitboard containing the other side's stones that would be flipped
+// by this side placing the given stone on an empty square (0 if the stone
+// would not be a legal move).
+uint64_t flip_bitboard(
+    uint64_t this_side_stones, uint64_t other_side_stones, uint64_t stone
+    );
+
+
+// <--------------------------------------------------------------------------->
+
+
+/*
+ * A region is a group of empty squares connected horizontally, vertically, or
+ * diagonally. Late in the game, the side that can play the last move in a
+ * region usually gains from it, so a region with an odd number of squares
+ * favors the side that moves into it first, and moves into odd regions tend to
+ * be better than moves into even ones.
+ *
+ * Regions are found by flood-filling from one empty square at a time. Since a
+ * move only changes the region it is played in, the searches keep the odd
+ * regions of each position on their stacks, and find those of a child by
+ * filling again only the region of the move.
+ */
+
+// Regions are only tracked once at most this many squares are empty. Before
+// then, there is nearly always one large region, and every square counts as
+// being in an even one.
+#define PARITY_MAX_EMPTIES 32
+
+// Returns the empty squares in regions with an odd number of squares (or 0, if
+// more than PARITY_MAX_EMPTIES squares are empty).
+uint64_t odd_regions(uint64_t empty_spaces);
+
+// Returns the odd-region squares after the stone is placed on one of the empty
+// squares, given the odd-region squares before it was placed.
+uint64_t odd_regions_after(
+    uint64_t odd_squares, uint64_t empty_spaces, uint64_t stone
+    );
+
+// Sets the odd-region squares of the board in board + 1, which must be the
+// board with the given stone added.
+static inline void update_odd_squares(Board board, uint64_t stone)
+{
+    (board + 1)->odd_squares = odd_regions_after(
+        board->odd_squares, ~(board->bits[WHITE] | board->bits[BLACK]), stone
+        );
+}
+
 // Finds the number of stones belonging to this side that are safe for at least
 // one move.
-uint8_t num_safe(
-    uint64_t this_side_stones, uint64_t other_side_stones,
-    uint64_t other_side_moves
-    );
+uint8_t num_safe(uint64_t this_side_stones, uint64_t other_side_stones);
 
 
 // <--------------------------------------------------------------------------->
 
 
+/*
+ * Each entry keeps its own copy of the board's stones (rather than a pointer to
+ * the board), so that checking whether an entry matches a board only touches
+ * the entry itself.
+ *
+ * Entries have no constructors: an all-zero entry is empty, so a table can be
+ * created just by mapping zero-filled memory.
+ */
+
 typedef struct table_entry_struct
 {
-    Board board;
+    uint64_t bits[2];
     bool in_use;
     uint8_t depth;
     int32_t score;
     uint64_t best_move, second_best_move, third_best_move;
     struct table_entry_struct* next;
-
-    table_entry_struct() { board = nullptr; in_use = false; next = nullptr; };
-    table_entry_struct(Board board) { this->board = board; in_use = false; next = nullptr; }
-    ~table_entry_struct() { if (this->next) { delete this->next; } }
 } *TableEntry;
 
-// Retrieves an entry from the transposition table for the given board.
-TableEntry get_entry(Board board, TableEntry table, size_t table_size);
+// The entries that can be added to the transposition table's collision chains.
+// They are allocated along with the table, so that the search never allocates
+// memory; the next unused one is taken with an atomic increment.
+typedef struct entry_pool_struct
+{
+    TableEntry entries;
+    size_t size, num_used;
+} *EntryPool;
+
+// Retrieves an entry from the transposition table for the given board. Once the
+// pool runs out, the last entry of a full chain is taken over instead.
+TableEntry get_entry(
+    Board board, TableEntry table, size_t table_size, EntryPool pool
+    );
+
+// Looks up the entry for the given board without adding one, returning nullptr
+// if the board is not in the table.
+TableEntry find_entry(Board board, TableEntry table, size_t table_size);
+
+// Starts loading the entry for a board with the given hash into the cache, so
+// that a later call to get_entry() for that board does not have to wait for
+// it. An entry can straddle two cache lines, so both are loaded.
+static inline void prefetch_entry(
+    uint64_t hash, TableEntry table, size_t table_size
+    )
+{
+    TableEntry entry = table + (hash & (table_size - 1));
+    __builtin_prefetch(entry);
+    __builtin_prefetch((char *) (entry + 1) - 1);
+}
 
 
 // <--------------------------------------------------------------------------->
@@ -169,25 +273,43 @@ TableEntry get_entry(Board board, TableEntry table, size_t table_size);
  * exceed 32 (if it did, that would mean that over half the board consisted of
  * legal moves). So, we can store a list of possible moves as an array of 32
  * integers, where each integer encodes a stone that can be played.
+ *
+ * The stones that each move flips are stored alongside it, since the search
+ * needs them several times for every move (to prefetch the child's table entry,
+ * to order the moves, and to make the move), and they are only computed once,
+ * when the moves are generated.
  */
 
 typedef struct movelist_struct
 {
     uint8_t num_moves;
     uint64_t moves[32];
+    uint64_t flips[32];
 } *Movelist;
 
 // Returns the specified move in the movelist.
 #define get_move(movelist, move_num) ((movelist)->moves[(move_num)])
 
+// Returns the stones flipped by the specified move in the movelist.
+#define get_flips(movelist, move_num) ((movelist)->flips[(move_num)])
+
 // Places all the moves available to the specified side in the given movelist,
-// as well as the number of moves available.
+// along with the stones they flip, as well as the number of moves available.
 void get_moves(Board board, Side side, Movelist movelist);
 
 // Optimally sorts the moves in the movelist based on the transposition table
 // entry.
 void sort_moves(Movelist movelist, TableEntry entry);
 
+// Moves the given move, and its flipped stones, to the front of the movelist,
+// keeping the other moves in the same order.
+void move_to_front(Movelist movelist, uint64_t move);
+
+// Sorts the moves in the movelist so that the ones which leave the other side
+// with the fewest replies come first, breaking ties in favor of moves into odd
+// regions (so the board's odd_squares must be up to date).
+void sort_moves_fastest_first(Board board, Side side, Movelist movelist);
+
 
 // <--------------------------------------------------------------------------->
 
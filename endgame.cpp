@@ -0,0 +1,501 @@
+#include "endgame.hpp"
+#include "profile.hpp"
+#include <thread>
+
+// Returns the final disc difference for this side when neither side can move,
+// counting the empty squares as the winner's (as in tournament scoring).
+static inline int32_t final_score(uint64_t this_stones, uint64_t other_stones)
+{
+    int32_t num_this_stones = num_ones(this_stones),
+    num_other_stones        = num_ones(other_stones),
+    num_empties             = 64 - num_this_stones - num_other_stones;
+
+    if (num_this_stones > num_other_stones)
+        return num_this_stones - num_other_stones + num_empties;
+
+    if (num_this_stones < num_other_stones)
+        return num_this_stones - num_other_stones - num_empties;
+
+    return 0;
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+// Mixed into the hash of a position with black to move, since the same stones
+// can come up with either side to move (after a pass).
+#define ENDGAME_BLACK_HASH 0x9E3779B97F4A7C15ULL
+
+// Returns the entry in the endgame table for the given position.
+static inline EndgameEntry get_endgame_entry(
+    Board board, Side side, EndgameEntry table, size_t table_size
+    )
+{
+    uint64_t hash = board->hash ^ ((side == BLACK) ? ENDGAME_BLACK_HASH : 0);
+    return table + (hash & (table_size - 1));
+}
+
+// Reads the bounds on the score of a position, and its best move (0 if it is
+// not known), from its entry, returning false if the entry holds some other
+// position.
+static inline bool probe_endgame_entry(
+    EndgameEntry entry, uint64_t mover, uint64_t opponent,
+    int32_t *lower, int32_t *upper, uint64_t *best_move
+    )
+{
+    uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+
+    if (
+        (__atomic_load_n(&entry->mover, __ATOMIC_RELAXED) ^ data) != mover ||
+        (__atomic_load_n(&entry->opponent, __ATOMIC_RELAXED) ^ data) !=
+        opponent
+        )
+        return false;
+
+    *lower = (int32_t) (data & 0xFF) - 64;
+    *upper = (int32_t) ((data >> 8) & 0xFF) - 64;
+
+    uint8_t square = (data >> 16) & 0xFF;
+    *best_move = (square < 64) ? 1ULL << square : 0;
+
+    return true;
+}
+
+// Stores the result of searching a position with the window (alpha, beta) in
+// its entry, replacing whatever the entry held before.
+static inline void store_endgame_entry(
+    EndgameEntry entry, uint64_t mover, uint64_t opponent, int32_t score,
+    int32_t alpha, int32_t beta, uint64_t best_move
+    )
+{
+    int32_t lower = (score > alpha) ? score : -64,
+    upper = (score < beta) ? score : 64;
+
+    uint64_t data = (uint64_t) (lower + 64) | (uint64_t) (upper + 64) << 8 |
+    (uint64_t) (best_move ? stone_position(best_move) : 64) << 16;
+
+    __atomic_store_n(&entry->mover, mover ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->opponent, opponent ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+// Returns true if the given split point, or any split point that it is below,
+// has been refuted.
+static inline bool aborted(SplitPoint split)
+{
+    for (; split; split = split->parent)
+        if (split->cutoff.load(memory_order_relaxed))
+            return true;
+
+    return false;
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+EndgameSolver::EndgameSolver(
+    EndgameEntry table, size_t table_size, SolvedDB *solvedb, int num_threads,
+    const atomic<bool> *stop
+    )
+{
+    this->table = table;
+    this->table_size = table_size;
+    this->solvedb = solvedb;
+    this->stop = stop;
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        SolverThread thread = new struct solver_thread_struct;
+        thread->nodes = 0;
+        thread->split = nullptr;
+        threads.push_back(thread);
+    }
+
+    // Every thread can own at most one split point per number of empty
+    // squares, so the list never has to grow during a solve.
+    split_points.reserve(num_threads * (MAX_ENDGAME_EMPTIES + 1));
+
+    // The helpers wait for split points from one solve to the next, so that
+    // no thread is started while solving.
+    done = false;
+    for (size_t i = 1; i < threads.size(); i++)
+        helpers.push_back(thread(&EndgameSolver::help, this, threads[i]));
+}
+
+EndgameSolver::~EndgameSolver()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        done = true;
+    }
+
+    work_available.notify_all();
+    for (size_t i = 0; i < helpers.size(); i++)
+        helpers[i].join();
+
+    for (size_t i = 0; i < threads.size(); i++)
+        delete threads[i];
+}
+
+size_t EndgameSolver::memory_bytes(int num_threads)
+{
+    return num_threads * (
+        sizeof(struct solver_thread_struct) +
+        (MAX_ENDGAME_EMPTIES + 1) * sizeof(SplitPoint)
+        );
+}
+
+uint64_t EndgameSolver::get_nodes()
+{
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < threads.size(); i++)
+        nodes += threads[i]->nodes;
+
+    return nodes;
+}
+
+uint64_t EndgameSolver::table_move(Board board, Side side)
+{
+    int32_t lower, upper;
+    uint64_t move;
+
+    if (!probe_endgame_entry(
+        get_endgame_entry(board, side, table, table_size),
+        get_stones(board, side), get_stones(board, !side), &lower, &upper,
+        &move
+        ))
+        return 0;
+
+    return move;
+}
+
+// Returns true if the solve has been stopped, or if the given split point (or
+// any split point that it is below) has been refuted.
+inline bool EndgameSolver::abandoned(SplitPoint split)
+{
+    return (stop && stop->load(memory_order_relaxed)) || aborted(split);
+}
+
+int32_t EndgameSolver::solve(Board board, Side side, uint64_t *best_move)
+{
+    // Every helper is idle between solves, since the owner of a split point
+    // waits for its helpers to finish before returning.
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i]->nodes = 0;
+
+    threads[0]->boards[0] = *board;
+    return
+    search(threads[0], threads[0]->boards, side, -65, 65, false, best_move);
+}
+
+// Searches the position with the given window. The score is exact if it lies
+// strictly between alpha and beta; otherwise, it is a bound. The root (the only
+// call given best_move) is always searched, so that its best move is found.
+//
+// If another thread refutes a split point that this subtree is below, or the
+// solve is stopped, the search returns early with a meaningless score, which the split point then
+// ignores; none of the positions in the subtree are stored.
+int32_t EndgameSolver::search(
+    SolverThread thread, Board board, Side side, int32_t alpha, int32_t beta,
+    bool passed, uint64_t *best_move
+    )
+{
+    thread->nodes++;
+
+    uint64_t this_stones = get_stones(board, side),
+    other_stones         = get_stones(board, !side),
+    moves;
+
+    {
+        PROFILE_SCOPE(PROFILE_MOVEGEN);
+        moves = move_bitboard(this_stones, other_stones);
+    }
+
+    // If this side cannot move, it must pass. If the other side has just
+    // passed as well, the game is over.
+    if (!moves)
+    {
+        if (passed)
+            return final_score(this_stones, other_stones);
+
+        return -search(thread, board, !side, -beta, -alpha, true, nullptr);
+    }
+
+    uint8_t num_empties = 64 - num_ones(this_stones | other_stones);
+
+    if (num_empties >= ENDGAME_ABORT_MIN_EMPTIES && abandoned(thread->split))
+        return alpha;
+
+    bool use_solvedb = solvedb && !best_move &&
+    num_empties >= SOLVEDB_MIN_EMPTIES && num_empties <= SOLVEDB_MAX_EMPTIES;
+
+    int32_t score;
+    if (use_solvedb && solvedb->probe(this_stones, other_stones, &score))
+        return score;
+
+    // Use the bounds from the table to cut off the search or narrow its
+    // window, and search the best move from the table first.
+    EndgameEntry entry = nullptr;
+    uint64_t table_move = 0;
+
+    if (num_empties >= ENDGAME_TABLE_MIN_EMPTIES)
+    {
+        PROFILE_SCOPE(PROFILE_TABLE);
+
+        entry = get_endgame_entry(board, side, table, table_size);
+
+        int32_t lower, upper;
+        if (
+            probe_endgame_entry(
+                entry, this_stones, other_stones, &lower, &upper, &table_move
+                ) &&
+            !best_move
+            )
+        {
+            if (lower >= beta || lower == upper)
+                return lower;
+            if (upper <= alpha)
+                return upper;
+
+            if (lower > alpha)
+                alpha = lower;
+            if (upper < beta)
+                beta = upper;
+        }
+    }
+
+    int32_t original_alpha = alpha;
+    uint64_t best = 0;
+
+    if (num_empties >= ENDGAME_SORT_MIN_EMPTIES)
+    {
+        Movelist movelist = thread->movelists + num_empties;
+        get_moves(board, side, movelist);
+        sort_moves_fastest_first(board, side, movelist);
+
+        if (table_move)
+            move_to_front(movelist, table_move);
+
+        for (size_t i = 0; i < movelist->num_moves; i++)
+        {
+            // Once the first move has failed to refute this node, let other
+            // threads help search the rest.
+            if (
+                i == 1 && threads.size() > 1 &&
+                num_empties >= ENDGAME_SPLIT_MIN_EMPTIES
+                )
+            {
+                alpha = split(
+                    thread, board, side, movelist, num_empties, alpha, beta,
+                    &best
+                    );
+                break;
+            }
+
+            add_stone_copy(
+                board, side, get_move(movelist, i), get_flips(movelist, i)
+                );
+            update_odd_squares(board, get_move(movelist, i));
+            score = -search(thread, board + 1, !side, -beta, -alpha, false,
+                nullptr);
+
+            if (score > alpha)
+            {
+                alpha = score;
+                best = get_move(movelist, i);
+
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+
+    else
+    {
+        // Search the table's move first, then the moves into odd regions, and
+        // then the rest, each in the order of their squares.
+        uint64_t odd_moves = moves & board->odd_squares,
+        move = (table_move & moves) ? table_move :
+        odd_moves ? odd_moves & -odd_moves : moves & -moves;
+
+        do
+        {
+            add_stone_copy(board, side, move);
+            update_odd_squares(board, move);
+            score = -search(thread, board + 1, !side, -beta, -alpha, false,
+                nullptr);
+
+            if (score > alpha)
+            {
+                alpha = score;
+                best = move;
+
+                if (alpha >= beta)
+                    break;
+            }
+
+            moves &= ~move;
+            odd_moves &= ~move;
+            move = odd_moves ? odd_moves & -odd_moves : moves & -moves;
+        } while (moves);
+    }
+
+    if (num_empties >= ENDGAME_ABORT_MIN_EMPTIES && abandoned(thread->split))
+        return alpha;
+
+    if (entry)
+        store_endgame_entry(
+            entry, this_stones, other_stones, alpha, original_alpha, beta, best
+            );
+
+    if (use_solvedb && alpha > original_alpha && alpha < beta)
+        solvedb->store(this_stones, other_stones, alpha);
+
+    if (best_move)
+        *best_move = best;
+
+    return alpha;
+}
+
+// Searches the moves of a node after the first, together with any idle
+// threads, and returns the node's score.
+int32_t EndgameSolver::split(
+    SolverThread thread, Board board, Side side, Movelist movelist,
+    uint8_t num_empties, int32_t alpha, int32_t beta, uint64_t *best_move
+    )
+{
+    struct split_point_struct split_point;
+    SplitPoint split = &split_point;
+
+    split->board = *board;
+    split->side = side;
+    split->movelist = movelist;
+    split->num_empties = num_empties;
+    split->next_move = 1;
+    split->alpha = alpha;
+    split->beta = beta;
+    split->best_move = *best_move;
+    split->cutoff = false;
+    split->num_helpers = 0;
+    split->parent = thread->split;
+
+    {
+        lock_guard<mutex> guard(lock);
+        split_points.push_back(split);
+    }
+
+    work_available.notify_all();
+
+    thread->split = split;
+    search_split_moves(thread, split, board);
+    thread->split = split->parent;
+
+    // Take the split point off the list, so that no more threads join it, and
+    // wait for the threads that have joined it to finish.
+    {
+        unique_lock<mutex> guard(lock);
+
+        for (size_t i = 0; i < split_points.size(); i++)
+            if (split_points[i] == split)
+            {
+                split_points.erase(split_points.begin() + i);
+                break;
+            }
+
+        while (split->num_helpers)
+            split_finished.wait(guard);
+    }
+
+    *best_move = split->best_move;
+    return split->alpha;
+}
+
+// Searches moves of the split point until there are none left (or it has been
+// refuted), using the search stack starting at board, which must hold the split
+// point's position.
+void EndgameSolver::search_split_moves(
+    SolverThread thread, SplitPoint split, Board board
+    )
+{
+    size_t i;
+
+    while (
+        !split->cutoff.load(memory_order_relaxed) &&
+        (i = split->next_move++) < split->movelist->num_moves
+        )
+    {
+        int32_t alpha;
+        {
+            lock_guard<mutex> guard(split->lock);
+            alpha = split->alpha;
+        }
+
+        uint64_t move = get_move(split->movelist, i);
+        add_stone_copy(board, split->side, move, get_flips(split->movelist, i));
+        update_odd_squares(board, move);
+
+        int32_t score = -search(
+            thread, board + 1, !split->side, -split->beta, -alpha, false,
+            nullptr
+            );
+
+        // The score is meaningless if the search was abandoned.
+        if (abandoned(split))
+            break;
+
+        lock_guard<mutex> guard(split->lock);
+
+        if (score > split->alpha)
+        {
+            split->alpha = score;
+            split->best_move = move;
+
+            if (score >= split->beta)
+                split->cutoff = true;
+        }
+    }
+}
+
+// Waits for split points with moves left to search, and helps search them,
+// until the solver is destroyed.
+void EndgameSolver::help(SolverThread thread)
+{
+    unique_lock<mutex> guard(lock);
+
+    while (!done)
+    {
+        // Join the split point closest to the root, since its moves have the
+        // largest subtrees.
+        SplitPoint split = nullptr;
+
+        for (size_t i = 0; i < split_points.size(); i++)
+            if (
+                !split_points[i]->cutoff &&
+                split_points[i]->next_move <
+                split_points[i]->movelist->num_moves &&
+                (!split || split_points[i]->num_empties > split->num_empties)
+                )
+                split = split_points[i];
+
+        if (!split)
+        {
+            work_available.wait(guard);
+            continue;
+        }
+
+        split->num_helpers++;
+        guard.unlock();
+
+        thread->boards[0] = split->board;
+        thread->split = split;
+        search_split_moves(thread, split, thread->boards);
+        thread->split = nullptr;
+
+        guard.lock();
+
+        if (--split->num_helpers == 0)
+            split_finished.notify_all();
+    }
+}
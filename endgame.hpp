@@ -0,0 +1,173 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <thread>
+#include "common.hpp"
+#include "board.hpp"
+#include "solvedb.hpp"
+#include "options.hpp"
+using namespace std;
+
+/*
+ * The endgame solver finds the final disc difference of a position with perfect
+ * play from both sides, using alpha-beta search on any number of threads.
+ *
+ * The threads share the work through split points (the "young brothers wait"
+ * scheme): once the first move at a node with enough empty squares has been
+ * searched without a cutoff, the node's other moves are offered to idle
+ * threads, which steal them one at a time and search them alongside the thread
+ * that owns the node. The first move is searched alone because it is usually
+ * the best one (moves near the root are sorted fastest-first), and its score
+ * narrows the window for the others. If a stolen move refutes the node, every
+ * thread still searching one of its moves, or a move below one of them, sees
+ * the cutoff at its next check and abandons its subtree.
+ *
+ * The threads also share the endgame table, a hash table of bounds on the
+ * scores of positions with enough empty squares to be worth remembering. Its
+ * entries are read and written without locks: each entry stores the position
+ * XOR-ed with its data, so an entry that is torn (half written by one thread
+ * and half by another) simply matches no position.
+ */
+
+// Positions with at least this many empty squares are kept in the endgame
+// table. Smaller subtrees are quicker to search again than to look up.
+#define ENDGAME_TABLE_MIN_EMPTIES 7
+
+// Nodes with at least this many empty squares sort their moves fastest-first;
+// closer to the end, the moves are searched in the order of their squares.
+#define ENDGAME_SORT_MIN_EMPTIES 10
+
+// Nodes with at least this many empty squares can be split between threads.
+// Smaller subtrees take less time to search than to hand to another thread.
+#define ENDGAME_SPLIT_MIN_EMPTIES 12
+
+// Nodes with at least this many empty squares check whether their subtree has
+// been refuted by another thread.
+#define ENDGAME_ABORT_MIN_EMPTIES 6
+
+typedef struct endgame_entry_struct
+{
+    // The position's stones, each XOR-ed with data.
+    uint64_t mover, opponent;
+
+    // The lower and upper bounds on the score (plus 64) in the lowest two
+    // bytes, and the square of the best move (or 64 if it is not known) in the
+    // next byte.
+    uint64_t data;
+} *EndgameEntry;
+
+// A node whose moves are being searched by several threads.
+typedef struct split_point_struct
+{
+    // The node's position and side to move, and its moves (in the owner's
+    // movelist, which is left alone until the split point is finished).
+    struct board_struct board;
+    Side side;
+    Movelist movelist;
+    uint8_t num_empties;
+
+    // The index of the next move to be searched by any thread.
+    atomic<size_t> next_move;
+
+    // The node's window, and the best move and score so far, which are only
+    // read or changed with lock held.
+    int32_t alpha, beta;
+    uint64_t best_move;
+    mutex lock;
+
+    // Set once a move has refuted the node.
+    atomic<bool> cutoff;
+
+    // The number of threads other than the owner searching the node's moves
+    // (only read or changed with the solver's lock held).
+    int num_helpers;
+
+    // The split point that the owner was searching a move of when it created
+    // this one, if any.
+    struct split_point_struct *parent;
+} *SplitPoint;
+
+class EndgameSolver {
+
+private:
+    // Everything that a single thread needs to search on its own.
+    typedef struct solver_thread_struct
+    {
+        // A search stack with room for one board per empty square, plus one
+        // for the root, and one movelist per number of empty squares.
+        struct board_struct boards[MAX_ENDGAME_EMPTIES + 2];
+        struct movelist_struct movelists[MAX_ENDGAME_EMPTIES + 1];
+
+        uint64_t nodes;
+
+        // The split point that the thread is searching a move of, if any.
+        SplitPoint split;
+    } *SolverThread;
+
+    EndgameEntry table;
+    size_t table_size;
+    SolvedDB *solvedb;
+
+    // Set by the owner to stop a solve early (nullptr if it never does).
+    const atomic<bool> *stop;
+
+    vector<SolverThread> threads;
+    vector<thread> helpers;
+
+    // Held while the list of split points (or a split point's helpers) is read
+    // or changed. Idle threads wait on work_available, and the owners of split
+    // points wait on split_finished for their helpers to finish.
+    mutex lock;
+    condition_variable work_available, split_finished;
+    vector<SplitPoint> split_points;
+
+    // Set when the solver is destroyed, to stop the helpers.
+    bool done;
+
+    bool abandoned(SplitPoint split);
+    int32_t search(
+        SolverThread thread, Board board, Side side, int32_t alpha,
+        int32_t beta, bool passed, uint64_t *best_move
+        );
+    int32_t split(
+        SolverThread thread, Board board, Side side, Movelist movelist,
+        uint8_t num_empties, int32_t alpha, int32_t beta, uint64_t *best_move
+        );
+    void search_split_moves(SolverThread thread, SplitPoint split, Board board);
+    void help(SolverThread thread);
+
+public:
+    // Creates a solver with the given number of threads, sharing the endgame
+    // table and the solved-position database (if it is not nullptr). The
+    // threads other than the caller's are started here, and wait for work
+    // until the solver is destroyed. Once stop (if it is not nullptr) is set,
+    // every solve returns within a few microseconds with a meaningless score.
+    EndgameSolver(
+        EndgameEntry table, size_t table_size, SolvedDB *solvedb,
+        int num_threads, const atomic<bool> *stop = nullptr
+        );
+    ~EndgameSolver();
+
+    // Returns the final disc difference for the side to move, which must have
+    // a move, and stores the move that achieves it in best_move.
+    int32_t solve(Board board, Side side, uint64_t *best_move);
+
+    // The number of positions searched by all the threads in the last solve.
+    uint64_t get_nodes();
+
+    // Returns the best move for the side to move that the endgame table holds
+    // for the position (0 if it holds none).
+    uint64_t table_move(Board board, Side side);
+
+    // The number of bytes that a solver with the given number of threads
+    // allocates.
+    static size_t memory_bytes(int num_threads);
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "engine.hpp"
+#include "memory.hpp"
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+// Returns the memory taken by an array of the given number of bytes that is
+// allocated with alloc_large(). A memory-bounded engine also counts the rest of
+// the array's last huge page, which is mapped but never used.
+static inline size_t array_bytes(size_t bytes, bool bounded)
+{
+    return bounded ? round_to_huge_pages(bytes) : bytes;
+}
+
+// Returns the memory taken by a transposition table with the given number of
+// entries, along with its pool.
+static inline size_t table_bytes(size_t table_size, bool bounded)
+{
+    return array_bytes(table_size * sizeof(struct table_entry_struct), bounded)
+    + array_bytes(
+        table_size / TABLE_POOL_DIVISOR * sizeof(struct table_entry_struct),
+        bounded
+        );
+}
+
+// Returns the memory taken by an endgame table with the given number of
+// entries.
+static inline size_t endgame_table_bytes(size_t table_size, bool bounded)
+{
+    return array_bytes(
+        table_size * sizeof(struct endgame_entry_struct), bounded
+        );
+}
+
+Engine::Engine(const EngineOptions &options)
+{
+    this->options = options;
+
+    // The solved-position database is opened first, since a memory-bounded
+    // engine has to leave room for it.
+    solvedb = nullptr;
+    if (!options.solvedb_file.empty())
+    {
+        solvedb = new SolvedDB(options.solvedb_file.c_str());
+        if (!solvedb->is_open())
+        {
+            delete solvedb;
+            solvedb = nullptr;
+        }
+    }
+
+    bool bounded = options.memory_mb > 0;
+    size_t table_limit = options.hash_mb << 20,
+    endgame_table_limit = options.endgame_hash_mb << 20,
+    fixed_bytes = 0;
+    planned_bytes = 0;
+
+    // A memory-bounded engine plans its whole footprint before allocating
+    // anything. Everything but the two tables has a fixed size: the engine
+    // itself, the search stacks and endgame solver of a player on each search
+    // thread, and the solved-position database (which is given room for a
+    // fixed number of new positions). The endgame table gets its share of the
+    // rest, and the transposition table gets whatever is left after that. If
+    // even the smallest tables do not fit, the engine exits before allocating
+    // them.
+    if (bounded)
+    {
+        if (solvedb)
+            solvedb->reserve(SOLVEDB_RESERVE_RECORDS);
+
+        fixed_bytes = sizeof(Engine) + options.threads * (
+            (options.max_depth + 2) * sizeof(struct board_struct) +
+            (options.max_depth + 1) * sizeof(struct movelist_struct) +
+            EndgameSolver::memory_bytes(options.solve_threads)
+            ) + (solvedb ? solvedb->memory_bytes() : 0);
+
+        size_t budget = options.memory_mb << 20,
+        tables_limit = (budget > fixed_bytes) ? budget - fixed_bytes : 0;
+
+        if (endgame_table_limit > tables_limit / ENDGAME_TABLE_SHARE)
+            endgame_table_limit = tables_limit / ENDGAME_TABLE_SHARE;
+
+        endgame_table_size = 1;
+        while (
+            endgame_table_bytes(2 * endgame_table_size, true) <=
+            endgame_table_limit
+            )
+            endgame_table_size <<= 1;
+
+        // The endgame table is at least a huge page, which can be more than
+        // what is left.
+        size_t endgame_bytes = endgame_table_bytes(endgame_table_size, true);
+        tables_limit =
+        (tables_limit > endgame_bytes) ? tables_limit - endgame_bytes : 0;
+        if (table_limit > tables_limit)
+            table_limit = tables_limit;
+    }
+
+    else
+    {
+        endgame_table_size = 1;
+        while (
+            endgame_table_bytes(2 * endgame_table_size, false) <=
+            endgame_table_limit
+            )
+            endgame_table_size <<= 1;
+    }
+
+    // Use the largest power-of-two number of entries that fits in the
+    // configured amount of memory, along with its pool.
+    table_size = 1;
+    while (table_bytes(2 * table_size, bounded) <= table_limit)
+        table_size <<= 1;
+
+    if (bounded)
+    {
+        planned_bytes = fixed_bytes + table_bytes(table_size, true) +
+        endgame_table_bytes(endgame_table_size, true);
+
+        if (planned_bytes > (options.memory_mb << 20))
+        {
+            cerr << "memory: a budget of " << options.memory_mb << " MB is " <<
+            "too small for the smallest tables, which need " <<
+            ((planned_bytes + (1 << 20) - 1) >> 20) << " MB" << endl;
+            exit(-1);
+        }
+    }
+
+    // The tables are zero-filled, which leaves every entry in the same state
+    // as its default constructor would (and every entry of the endgame table
+    // empty). If an allocation fails, halve the size of the table until it
+    // succeeds, giving up once it would be smaller than one huge page.
+    while (!(table = (TableEntry) alloc_large(
+        table_size * sizeof(struct table_entry_struct), options.threads
+        )))
+    {
+        table_size >>= 1;
+        if (table_size * sizeof(struct table_entry_struct) < HUGE_PAGE_SIZE)
+        {
+            cerr << "engine: could not allocate the transposition table" <<
+            endl;
+            exit(-1);
+        }
+    }
+
+    pool.size = table_size / TABLE_POOL_DIVISOR;
+    pool.num_used = 0;
+    pool.entries = (TableEntry) alloc_large(
+        pool.size * sizeof(struct table_entry_struct), options.threads
+        );
+    if (!pool.entries)
+        pool.size = 0;
+
+    while (!(endgame_table = (EndgameEntry) alloc_large(
+        endgame_table_size * sizeof(struct endgame_entry_struct),
+        options.solve_threads
+        )))
+    {
+        endgame_table_size >>= 1;
+        if (
+            endgame_table_size * sizeof(struct endgame_entry_struct) <
+            HUGE_PAGE_SIZE
+            )
+        {
+            cerr << "engine: could not allocate the endgame table" << endl;
+            exit(-1);
+        }
+    }
+
+    // Fault in every page of a memory-bounded engine now, so that a limit on
+    // the process's memory is hit here rather than in the middle of a game,
+    // and report what was planned and what is resident.
+    if (bounded)
+    {
+        wait_large(table);
+        if (pool.entries)
+            wait_large(pool.entries);
+        wait_large(endgame_table);
+
+        // The tables may have been shrunk to allocate them.
+        planned_bytes = fixed_bytes + table_bytes(table_size, true) +
+        endgame_table_bytes(endgame_table_size, true);
+
+        cerr << "memory: " << (planned_bytes >> 20) << " of " <<
+        options.memory_mb << " MB planned (" <<
+        (table_bytes(table_size, true) >> 20) << " MB table, " <<
+        (endgame_table_bytes(endgame_table_size, true) >> 20) <<
+        " MB endgame table, " << (fixed_bytes >> 10) << " KB other), " <<
+        (resident_bytes() >> 20) << " MB resident" << endl;
+    }
+
+    // The weight of each part of the heuristic changes linearly from its
+    // starting value on the first turn to its ending value on the last turn.
+    // Only the stone imbalance has a nonzero ending value, and only parity
+    // (which only matters late in the game) starts from zero.
+    int32_t start[NUM_WEIGHTS] = {
+        options.stoneimb_mult_start, options.mobility_mult_start,
+        options.pmobility_mult_start, options.corners_mult_start,
+        options.pcorners_mult_start, options.safety_mult_start, 0
+    },
+    ends[NUM_WEIGHTS] = {
+        options.stoneimb_mult_end, 0, 0, 0, 0, 0, options.parity_mult_end
+    };
+
+    for (int i = 0; i < NUM_WEIGHTS; i++)
+    {
+        int32_t end = ends[i],
+        change = (end - start[i]) / 60;
+
+        for (int turn = 0; turn < 60; turn++)
+            weights[turn][i] = start[i] + change * turn;
+
+        weights[60][i] = end;
+    }
+
+    // Moves that come later in the search order are less likely to be best, so
+    // they are reduced more, as are moves at greater depths:
+    //
+    //   reduction = base + ln(depth) * ln(index) / divisor
+    //
+    // rounded down to an even number of plies, since the heuristic tends to
+    // favor one side at odd depths and the other at even depths, and a reduced
+    // search should end on the same side as a full one. A reduced move is
+    // still searched to a depth of at least 1.
+    for (int depth = 0; depth <= MAX_MAX_DEPTH; depth++)
+        for (int i = 0; i < 32; i++)
+        {
+            int reduction = 0;
+
+            if (
+                options.lmr && depth >= options.lmr_min_depth &&
+                i >= options.lmr_min_moves && i > 0
+                )
+                reduction = (int) (
+                    (options.lmr_base +
+                    10000 * log(depth) * log(i) / options.lmr_divisor) / 100
+                    );
+
+            if (reduction > depth - 2)
+                reduction = (depth > 2) ? depth - 2 : 0;
+
+            reductions[depth][i] = reduction & ~1;
+        }
+}
+
+Engine::~Engine()
+{
+    free_large(table, table_size * sizeof(struct table_entry_struct));
+    if (pool.entries)
+        free_large(
+            pool.entries, pool.size * sizeof(struct table_entry_struct)
+            );
+    free_large(
+        endgame_table,
+        endgame_table_size * sizeof(struct endgame_entry_struct)
+        );
+
+    if (solvedb)
+        delete solvedb;
+}
@@ -0,0 +1,72 @@
+#ifndef __ENGINE_H__
+#define __ENGINE_H__
+
+#include <cstdint>
+#include "board.hpp"
+#include "solvedb.hpp"
+#include "endgame.hpp"
+#include "options.hpp"
+using namespace std;
+
+// The number of transposition table entries for each entry in the pool of
+// entries for its collision chains.
+#define TABLE_POOL_DIVISOR 4
+
+// A memory-bounded engine gives at most this fraction (one in so many bytes) of
+// the memory left for its tables to the endgame table.
+#define ENDGAME_TABLE_SHARE 8
+
+// The number of new positions that a memory-bounded engine leaves room for in
+// the solved-position database.
+#define SOLVEDB_RESERVE_RECORDS (1 << 16)
+
+// The indices of the heuristic's weights in each row of the weight table.
+enum Weight {
+    STONEIMB_WEIGHT, MOBILITY_WEIGHT, PMOBILITY_WEIGHT, CORNERS_WEIGHT,
+    PCORNERS_WEIGHT, SAFETY_WEIGHT, PARITY_WEIGHT, NUM_WEIGHTS
+};
+
+/*
+ * The engine holds everything that is expensive to set up and can be shared by
+ * any number of players, including players searching at the same time on
+ * different threads: the transposition table, the solved-position database, and
+ * the heuristic's weight table. Each Player only owns its board, its search
+ * stacks, and its endgame solver, so a new game can be started on an existing
+ * engine in microseconds (when the solver has a single thread).
+ *
+ * With a memory limit (options.memory_mb), the engine sizes its tables so that
+ * its whole footprint fits, and faults all of its memory in before returning;
+ * after that, nothing is allocated while searching.
+ */
+
+class Engine {
+
+public:
+    EngineOptions options;
+
+    TableEntry table;
+    size_t table_size;
+    struct entry_pool_struct pool;
+
+    SolvedDB *solvedb;
+
+    // The endgame solver's table of bounds, shared by every solve.
+    EndgameEntry endgame_table;
+    size_t endgame_table_size;
+
+    // The memory that a memory-bounded engine planned for, in bytes (0 if the
+    // engine is not memory-bounded).
+    size_t planned_bytes;
+
+    // The heuristic's weights for every turn, precomputed from the options.
+    int32_t weights[61][NUM_WEIGHTS];
+
+    // The number of plies by which a null-window search reduces the move at
+    // each index of a movelist, at each depth, precomputed from the options.
+    uint8_t reductions[MAX_MAX_DEPTH + 1][32];
+
+    Engine(const EngineOptions &options);
+    ~Engine();
+};
+
+#endif
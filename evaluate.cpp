@@ -0,0 +1,429 @@
+#include "evaluate.hpp"
+#include "board.hpp"
+#include "profile.hpp"
+#include <immintrin.h>
+
+// The number of stones, moves, spaces (empty squares next to the side's
+// stones), corners, corner moves, safe stones, and moves into odd regions of
+// both sides.
+typedef struct counts_struct
+{
+    int32_t this_stones, other_stones, this_moves, other_moves,
+    this_spaces, other_spaces, this_corners, other_corners,
+    this_corner_moves, other_corner_moves, this_safe, other_safe,
+    this_parity_moves, other_parity_moves;
+} *Counts;
+
+// Combines the counts into a score, using the given row of the weight table.
+// This is shared by the scalar and batch versions of the heuristic, so that
+// they always give the same scores.
+static inline int32_t score_counts(Counts counts, const int32_t *weight)
+{
+    // STONE IMBALANCE
+    // There is no need to check whether this_stones + other_stones is nonzero,
+    // since there will always be at least 4 stones on the board.
+    int32_t score = weight[STONEIMB_WEIGHT] *
+    (counts->this_stones - counts->other_stones) /
+    (counts->this_stones + counts->other_stones);
+
+    // MOBILITY
+    if (counts->this_moves + counts->other_moves)
+        score += weight[MOBILITY_WEIGHT] *
+        (counts->this_moves - counts->other_moves) /
+        (counts->this_moves + counts->other_moves);
+
+    // POTENTIAL MOBILITY
+    // There is no need to check whether other_spaces + this_spaces is nonzero,
+    // since there will only be 0 spaces on the board on the 60th turn.
+    score += weight[PMOBILITY_WEIGHT] *
+    (counts->other_spaces - counts->this_spaces) /
+    (counts->other_spaces + counts->this_spaces);
+
+    // CORNERS
+    if (counts->this_corners + counts->other_corners)
+        score += weight[CORNERS_WEIGHT] *
+        (counts->this_corners - counts->other_corners) /
+        (counts->this_corners + counts->other_corners);
+
+    // POTENTIAL CORNERS
+    if (counts->this_corner_moves + counts->other_corner_moves)
+        score += weight[PCORNERS_WEIGHT] *
+        (counts->this_corner_moves - counts->other_corner_moves) /
+        (counts->this_corner_moves + counts->other_corner_moves);
+
+    // SAFETY
+    if (counts->this_safe + counts->other_safe)
+        score += weight[SAFETY_WEIGHT] *
+        (counts->this_safe - counts->other_safe) /
+        (counts->this_safe + counts->other_safe);
+
+    // PARITY
+    if (counts->this_parity_moves + counts->other_parity_moves)
+        score += weight[PARITY_WEIGHT] *
+        (counts->this_parity_moves - counts->other_parity_moves) /
+        (counts->this_parity_moves + counts->other_parity_moves);
+
+    return score;
+}
+
+int32_t evaluate(
+    uint64_t this_stones, uint64_t other_stones,
+    const int32_t (*weights)[NUM_WEIGHTS]
+    )
+{
+    return evaluate(
+        this_stones, other_stones, odd_regions(~(this_stones | other_stones)),
+        weights
+        );
+}
+
+int32_t evaluate(
+    uint64_t this_stones, uint64_t other_stones, uint64_t odd_squares,
+    const int32_t (*weights)[NUM_WEIGHTS]
+    )
+{
+    PROFILE_SCOPE(PROFILE_EVAL_OTHER);
+
+    struct counts_struct counts;
+
+    counts.this_stones  = num_ones(this_stones);
+    counts.other_stones = num_ones(other_stones);
+
+    uint8_t turn = counts.this_stones + counts.other_stones - 4;
+
+    // On the last turn, the only part of the heuristic that matters is the
+    // stone imbalance, so all further calculations can be avoided.
+    if (turn == 60)
+        return weights[60][STONEIMB_WEIGHT] *
+        (counts.this_stones - counts.other_stones) /
+        (counts.this_stones + counts.other_stones);
+
+    uint64_t this_moves, other_moves;
+    {
+        PROFILE_SCOPE(PROFILE_EVAL_MOBILITY);
+        this_moves  = move_bitboard(this_stones, other_stones);
+        other_moves = move_bitboard(other_stones, this_stones);
+    }
+
+    counts.this_moves         = num_ones(this_moves);
+    counts.other_moves        = num_ones(other_moves);
+    counts.this_spaces        = num_spaces(this_stones, other_stones);
+    counts.other_spaces       = num_spaces(other_stones, this_stones);
+    counts.this_corners       = num_corners(this_stones);
+    counts.other_corners      = num_corners(other_stones);
+    counts.this_corner_moves  = num_corners(this_moves);
+    counts.other_corner_moves = num_corners(other_moves);
+    counts.this_parity_moves  = num_ones(this_moves & odd_squares);
+    counts.other_parity_moves = num_ones(other_moves & odd_squares);
+
+    {
+        PROFILE_SCOPE(PROFILE_EVAL_SAFETY);
+        counts.this_safe  = (counts.other_moves) ?
+        num_safe(this_stones, other_stones) : counts.this_stones;
+        counts.other_safe = (counts.this_moves) ?
+        num_safe(other_stones, this_stones) : counts.other_stones;
+    }
+
+    return score_counts(&counts, weights[turn]);
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+/*
+ * The AVX2 versions of the board functions below are line-by-line translations
+ * of the ones in board.cpp, operating on 4 bitboards at once. They are compiled
+ * for AVX2 regardless of the compiler flags, and are only called if the
+ * processor turns out to support AVX2.
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i shift_down(__m256i x, int shift_amount)
+{
+    return _mm256_slli_epi64(x, shift_amount);
+}
+
+AVX2 static inline __m256i shift_up(__m256i x, int shift_amount)
+{
+    return _mm256_srli_epi64(x, shift_amount);
+}
+
+// Finds the Hamming Weight of each lane, by looking up the weight of each
+// nibble and summing the weights within each lane.
+AVX2 static inline __m256i num_ones_256(__m256i x)
+{
+    const __m256i nibble_weights = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+        ),
+    low_nibbles = _mm256_set1_epi8(0x0F);
+
+    __m256i weights = _mm256_add_epi8(
+        _mm256_shuffle_epi8(nibble_weights, _mm256_and_si256(x, low_nibbles)),
+        _mm256_shuffle_epi8(
+            nibble_weights,
+            _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibbles)
+            )
+        );
+
+    return _mm256_sad_epu8(weights, _mm256_setzero_si256());
+}
+
+AVX2 static inline __m256i num_spaces_256(
+    __m256i this_side_stones, __m256i other_side_stones
+    )
+{
+    const __m256i r_edge = _mm256_set1_epi64x(R_EDGE),
+    l_edge = _mm256_set1_epi64x(L_EDGE);
+
+    __m256i r_stones = _mm256_and_si256(this_side_stones, r_edge),
+    l_stones = _mm256_and_si256(this_side_stones, l_edge),
+    neighbors =
+    _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_or_si256(shift_down(r_stones, 1), shift_down(l_stones, 7)),
+            _mm256_or_si256(
+                shift_down(this_side_stones, 8), shift_down(r_stones, 9)
+                )
+            ),
+        _mm256_or_si256(
+            _mm256_or_si256(shift_up(l_stones, 1), shift_up(r_stones, 7)),
+            _mm256_or_si256(shift_up(this_side_stones, 8), shift_up(l_stones, 9))
+            )
+        );
+
+    return num_ones_256(_mm256_andnot_si256(
+        _mm256_or_si256(this_side_stones, other_side_stones), neighbors
+        ));
+}
+
+AVX2 static inline __m256i downward_fill_256(
+    __m256i stones, __m256i other_side, int shift_amount
+    )
+{
+    stones = _mm256_and_si256(shift_down(stones, shift_amount), other_side);
+
+    for (int i = 0; i < 5; i++)
+        stones = _mm256_or_si256(
+            stones, _mm256_and_si256(shift_down(stones, shift_amount), other_side)
+            );
+
+    return stones;
+}
+
+AVX2 static inline __m256i upward_fill_256(
+    __m256i stones, __m256i other_side, int shift_amount
+    )
+{
+    stones = _mm256_and_si256(shift_up(stones, shift_amount), other_side);
+
+    for (int i = 0; i < 5; i++)
+        stones = _mm256_or_si256(
+            stones, _mm256_and_si256(shift_up(stones, shift_amount), other_side)
+            );
+
+    return stones;
+}
+
+AVX2 static inline __m256i downward_moves_256(
+    __m256i this_side, __m256i other_side, __m256i empty_spaces,
+    int shift_amount
+    )
+{
+    this_side = _mm256_and_si256(shift_down(this_side, shift_amount), other_side);
+
+    for (int i = 0; i < 5; i++)
+        this_side = _mm256_or_si256(
+            this_side,
+            _mm256_and_si256(shift_down(this_side, shift_amount), other_side)
+            );
+
+    return _mm256_and_si256(shift_down(this_side, shift_amount), empty_spaces);
+}
+
+AVX2 static inline __m256i upward_moves_256(
+    __m256i this_side, __m256i other_side, __m256i empty_spaces,
+    int shift_amount
+    )
+{
+    this_side = _mm256_and_si256(shift_up(this_side, shift_amount), other_side);
+
+    for (int i = 0; i < 5; i++)
+        this_side = _mm256_or_si256(
+            this_side,
+            _mm256_and_si256(shift_up(this_side, shift_amount), other_side)
+            );
+
+    return _mm256_and_si256(shift_up(this_side, shift_amount), empty_spaces);
+}
+
+AVX2 static inline __m256i all_moves_256(__m256i this_side, __m256i other_side)
+{
+    const __m256i r_edge = _mm256_set1_epi64x(R_EDGE),
+    l_edge = _mm256_set1_epi64x(L_EDGE);
+
+    __m256i empty_spaces = _mm256_xor_si256(
+        _mm256_or_si256(this_side, other_side), _mm256_set1_epi64x(-1)
+        ),
+    this_r = _mm256_and_si256(this_side, r_edge),
+    this_l = _mm256_and_si256(this_side, l_edge),
+    other_r = _mm256_and_si256(other_side, r_edge),
+    other_l = _mm256_and_si256(other_side, l_edge);
+
+    return
+    _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_or_si256(
+                downward_moves_256(this_r, other_r, empty_spaces, 1),
+                downward_moves_256(this_l, other_l, empty_spaces, 7)
+                ),
+            _mm256_or_si256(
+                downward_moves_256(this_side, other_side, empty_spaces, 8),
+                downward_moves_256(this_r, other_r, empty_spaces, 9)
+                )
+            ),
+        _mm256_or_si256(
+            _mm256_or_si256(
+                upward_moves_256(this_l, other_l, empty_spaces, 1),
+                upward_moves_256(this_r, other_r, empty_spaces, 7)
+                ),
+            _mm256_or_si256(
+                upward_moves_256(this_side, other_side, empty_spaces, 8),
+                upward_moves_256(this_l, other_l, empty_spaces, 9)
+                )
+            )
+        );
+}
+
+// Finds the number of this side's stones that are not flipped by any of the
+// other side's moves, by looking for lines of this side's stones with an empty
+// square at one end and one of the other side's stones at the other.
+AVX2 static inline __m256i num_safe_256(
+    __m256i this_side_stones, __m256i other_side_stones
+    )
+{
+    const __m256i inner_columns = _mm256_set1_epi64x(R_EDGE & L_EDGE);
+
+    __m256i empty_spaces = _mm256_xor_si256(
+        _mm256_or_si256(this_side_stones, other_side_stones),
+        _mm256_set1_epi64x(-1)
+        ),
+    inner = _mm256_and_si256(this_side_stones, inner_columns),
+    other = other_side_stones,
+    flippable_stones = _mm256_or_si256(
+        _mm256_and_si256(
+            downward_fill_256(empty_spaces, this_side_stones, 8),
+            upward_fill_256(other, this_side_stones, 8)
+            ),
+        _mm256_and_si256(
+            upward_fill_256(empty_spaces, this_side_stones, 8),
+            downward_fill_256(other, this_side_stones, 8)
+            )
+        );
+
+    // right and left, down-left and up-right, and down-right and up-left
+    const int shift_amounts[3] = {1, 7, 9};
+
+    for (int i = 0; i < 3; i++)
+        flippable_stones = _mm256_or_si256(
+            flippable_stones,
+            _mm256_or_si256(
+                _mm256_and_si256(
+                    downward_fill_256(empty_spaces, inner, shift_amounts[i]),
+                    upward_fill_256(other, inner, shift_amounts[i])
+                    ),
+                _mm256_and_si256(
+                    upward_fill_256(empty_spaces, inner, shift_amounts[i]),
+                    downward_fill_256(other, inner, shift_amounts[i])
+                    )
+                )
+            );
+
+    return num_ones_256(_mm256_andnot_si256(flippable_stones, this_side_stones));
+}
+
+// Scores 4 positions.
+AVX2 static void evaluate_4(
+    const uint64_t (*positions)[2], const int32_t (*weights)[NUM_WEIGHTS],
+    int32_t *scores
+    )
+{
+    const __m256i corners = _mm256_set1_epi64x(CORNERS);
+
+    __m256i this_stones = _mm256_setr_epi64x(
+        positions[0][0], positions[1][0], positions[2][0], positions[3][0]
+        ),
+    other_stones = _mm256_setr_epi64x(
+        positions[0][1], positions[1][1], positions[2][1], positions[3][1]
+        ),
+    this_moves = all_moves_256(this_stones, other_stones),
+    other_moves = all_moves_256(other_stones, this_stones);
+
+    // Regions are found one at a time, so they are found separately for each
+    // position.
+    uint64_t odd_squares[4];
+    for (int lane = 0; lane < 4; lane++)
+        odd_squares[lane] =
+        odd_regions(~(positions[lane][0] | positions[lane][1]));
+
+    __m256i odd = _mm256_loadu_si256((const __m256i *) odd_squares);
+
+    __m256i lanes[14] = {
+        num_ones_256(this_stones),
+        num_ones_256(other_stones),
+        num_ones_256(this_moves),
+        num_ones_256(other_moves),
+        num_spaces_256(this_stones, other_stones),
+        num_spaces_256(other_stones, this_stones),
+        num_ones_256(_mm256_and_si256(this_stones, corners)),
+        num_ones_256(_mm256_and_si256(other_stones, corners)),
+        num_ones_256(_mm256_and_si256(this_moves, corners)),
+        num_ones_256(_mm256_and_si256(other_moves, corners)),
+        num_safe_256(this_stones, other_stones),
+        num_safe_256(other_stones, this_stones),
+        num_ones_256(_mm256_and_si256(this_moves, odd)),
+        num_ones_256(_mm256_and_si256(other_moves, odd))
+    };
+
+    uint64_t values[14][4];
+    for (int i = 0; i < 14; i++)
+        _mm256_storeu_si256((__m256i *) values[i], lanes[i]);
+
+    for (int lane = 0; lane < 4; lane++)
+    {
+        struct counts_struct counts = {
+            (int32_t) values[0][lane], (int32_t) values[1][lane],
+            (int32_t) values[2][lane], (int32_t) values[3][lane],
+            (int32_t) values[4][lane], (int32_t) values[5][lane],
+            (int32_t) values[6][lane], (int32_t) values[7][lane],
+            (int32_t) values[8][lane], (int32_t) values[9][lane],
+            (int32_t) values[10][lane], (int32_t) values[11][lane],
+            (int32_t) values[12][lane], (int32_t) values[13][lane]
+        };
+
+        uint8_t turn = counts.this_stones + counts.other_stones - 4;
+
+        scores[lane] = (turn == 60) ?
+        weights[60][STONEIMB_WEIGHT] *
+        (counts.this_stones - counts.other_stones) /
+        (counts.this_stones + counts.other_stones) :
+        score_counts(&counts, weights[turn]);
+    }
+}
+
+void evaluate_batch(
+    const uint64_t (*positions)[2], size_t num_positions,
+    const int32_t (*weights)[NUM_WEIGHTS], int32_t *scores
+    )
+{
+    size_t i = 0;
+
+    if (__builtin_cpu_supports("avx2"))
+        for (; i + 4 <= num_positions; i += 4)
+            evaluate_4(positions + i, weights, scores + i);
+
+    for (; i < num_positions; i++)
+        scores[i] = evaluate(positions[i][0], positions[i][1], weights);
+}
@@ -0,0 +1,45 @@
+#ifndef __EVALUATE_H__
+#define __EVALUATE_H__
+
+#include <cstdint>
+#include <cstddef>
+#include "engine.hpp"
+using namespace std;
+
+/*
+ * The heuristic scores a position from one side's point of view, using seven
+ * parameters: stone imbalance, mobility, potential mobility, corners, potential
+ * corners, safety, and parity (moves into odd regions; see board.hpp and the
+ * README). Each parameter is the difference between the two sides' counts,
+ * divided by their sum and multiplied by the parameter's weight for the
+ * current turn.
+ *
+ * Positions can be scored one at a time, or many at a time; with AVX2, the
+ * batch version counts the parameters of 4 positions at once, one position in
+ * each 64-bit lane, and gives exactly the same scores as the scalar version.
+ * Every position must contain at least 4 stones (as any position reached in a
+ * game does).
+ */
+
+// Scores the position for this side.
+int32_t evaluate(
+    uint64_t this_stones, uint64_t other_stones,
+    const int32_t (*weights)[NUM_WEIGHTS]
+    );
+
+// The same, for a position whose odd-region squares (see odd_regions()) are
+// already known.
+int32_t evaluate(
+    uint64_t this_stones, uint64_t other_stones, uint64_t odd_squares,
+    const int32_t (*weights)[NUM_WEIGHTS]
+    );
+
+// Scores each of the positions, given as pairs of bitboards {this side's
+// stones, other side's stones}, for the side whose stones come first, storing
+// the scores in the corresponding elements of scores.
+void evaluate_batch(
+    const uint64_t (*positions)[2], size_t num_positions,
+    const int32_t (*weights)[NUM_WEIGHTS], int32_t *scores
+    );
+
+#endif
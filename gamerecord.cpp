@@ -0,0 +1,265 @@
+#include "gamerecord.hpp"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+GameRecord::GameRecord()
+{
+    start_ms = black_ms = white_ms = 0;
+}
+
+void GameRecord::add_move(Move *move)
+{
+    moves.push_back(move ? 8 * move->y + move->x : GAMERECORD_PASS);
+}
+
+int8_t game_result(Board board)
+{
+    int num_black = num_ones(board->bits[BLACK]),
+    num_white     = num_ones(board->bits[WHITE]),
+    num_empties   = 64 - num_black - num_white;
+
+    if (num_black > num_white)
+        return num_black - num_white + num_empties;
+
+    if (num_black < num_white)
+        return num_black - num_white - num_empties;
+
+    return 0;
+}
+
+bool game_over(Board board)
+{
+    return
+    !move_bitboard(board->bits[BLACK], board->bits[WHITE]) &&
+    !move_bitboard(board->bits[WHITE], board->bits[BLACK]);
+}
+
+// Checks that the file begins with a game record file header.
+static bool check_header(GameRecordFileHeader header)
+{
+    return
+    !memcmp(header->magic, GAMERECORD_MAGIC, sizeof(header->magic)) &&
+    header->version == GAMERECORD_VERSION &&
+    header->header_size == sizeof(struct gamerecord_header_struct);
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+GameWriter::GameWriter(const char *path)
+{
+    fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        cerr << "gamerecord: could not open " << path << endl;
+        return;
+    }
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+
+    struct gamerecord_file_header_struct header;
+
+    if (file_stat.st_size == 0)
+    {
+        // Start a new file.
+        memset(&header, 0, sizeof(header));
+        strcpy(header.magic, GAMERECORD_MAGIC);
+        header.version = GAMERECORD_VERSION;
+        header.header_size = sizeof(struct gamerecord_header_struct);
+
+        if (::write(fd, &header, sizeof(header)) != sizeof(header))
+        {
+            cerr << "gamerecord: could not write to " << path << endl;
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    else if (
+        pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        !check_header(&header)
+        )
+    {
+        cerr << "gamerecord: " << path << " is not a game record file" << endl;
+        close(fd);
+        fd = -1;
+    }
+}
+
+GameWriter::~GameWriter()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool GameWriter::write(const GameRecord &game)
+{
+    if (fd < 0 || game.moves.size() > UINT8_MAX)
+        return false;
+
+    // Replay the game to find its result.
+    struct board_struct board;
+    set_bits(&board, 0x0000001008000000, 0x0000000810000000);
+    Side side = BLACK;
+
+    for (size_t i = 0; i < game.moves.size(); i++)
+    {
+        if (game.moves[i] != GAMERECORD_PASS)
+            add_stone(&board, side, 1ULL << game.moves[i]);
+        side = !side;
+    }
+
+    struct gamerecord_header_struct header;
+    memset(&header, 0, sizeof(header));
+
+    string black_name = game.black_name.substr(0, UINT8_MAX),
+    white_name = game.white_name.substr(0, UINT8_MAX);
+
+    header.result =
+    game_over(&board) ? game_result(&board) : GAMERECORD_UNKNOWN_RESULT;
+    header.num_moves = game.moves.size();
+    header.black_name_length = black_name.size();
+    header.white_name_length = white_name.size();
+    header.start_ms = game.start_ms;
+    header.black_ms = game.black_ms;
+    header.white_ms = game.white_ms;
+
+    size_t length = sizeof(header) + black_name.size() + white_name.size() +
+    game.moves.size();
+    header.size = (length + 3) & ~3;
+
+    // Build the whole game first, so that it is appended in one piece.
+    vector<char> buffer(header.size, 0);
+    char *position = buffer.data();
+
+    memcpy(position, &header, sizeof(header));
+    position += sizeof(header);
+    memcpy(position, black_name.data(), black_name.size());
+    position += black_name.size();
+    memcpy(position, white_name.data(), white_name.size());
+    position += white_name.size();
+    memcpy(position, game.moves.data(), game.moves.size());
+
+    return ::write(fd, buffer.data(), buffer.size()) == (ssize_t) buffer.size();
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+GameReader::GameReader(const char *path)
+{
+    data = nullptr;
+    size = offset = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        cerr << "gamerecord: could not open " << path << endl;
+        return;
+    }
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+
+    if (
+        (size_t) file_stat.st_size >=
+        sizeof(struct gamerecord_file_header_struct)
+        )
+    {
+        void *mapped = mmap(
+            nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0
+            );
+
+        if (mapped != MAP_FAILED)
+        {
+            data = (const char *) mapped;
+            size = file_stat.st_size;
+        }
+    }
+
+    close(fd);
+
+    if (!data || !check_header((GameRecordFileHeader) data))
+    {
+        cerr << "gamerecord: " << path << " is not a game record file" << endl;
+
+        if (data)
+            munmap((void *) data, size);
+        data = nullptr;
+        size = 0;
+        return;
+    }
+
+    // The games are read in order from start to finish.
+    madvise((void *) data, size, MADV_SEQUENTIAL);
+    rewind();
+}
+
+GameReader::~GameReader()
+{
+    if (data)
+        munmap((void *) data, size);
+}
+
+void GameReader::rewind()
+{
+    offset = sizeof(struct gamerecord_file_header_struct);
+}
+
+bool GameReader::next(GameView game)
+{
+    if (!data || offset + sizeof(struct gamerecord_header_struct) > size)
+        return false;
+
+    GameRecordHeader header = (GameRecordHeader) (data + offset);
+
+    if (
+        offset + header->size > size ||
+        header->size < sizeof(struct gamerecord_header_struct) +
+        header->black_name_length + header->white_name_length +
+        header->num_moves
+        )
+        return false;
+
+    game->header = header;
+    game->black_name = (const char *) (header + 1);
+    game->white_name = game->black_name + header->black_name_length;
+    game->moves =
+    (const uint8_t *) (game->white_name + header->white_name_length);
+
+    offset += header->size;
+    return true;
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+GameReplay::GameReplay(GameView game)
+{
+    set_bits(&board, 0x0000001008000000, 0x0000000810000000);
+    side = BLACK;
+    move = game->moves;
+    end = game->moves + game->header->num_moves;
+}
+
+bool GameReplay::step()
+{
+    // Stop at the end of the game, or at a corrupt move.
+    if (move == end || *move > GAMERECORD_PASS)
+        return false;
+
+    if (*move != GAMERECORD_PASS)
+        add_stone(&board, side, 1ULL << *move);
+
+    move++;
+    side = !side;
+    return true;
+}
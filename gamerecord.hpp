@@ -0,0 +1,168 @@
+#ifndef __GAMERECORD_H__
+#define __GAMERECORD_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+using namespace std;
+
+/*
+ * Game records are kept in append-only files, which begin with a small header
+ * and are followed by any number of games:
+ *
+ * +--------+---------+-------------+--------+--------+-----
+ * | magic  | version | header_size | game 0 | game 1 | ...
+ * +--------+---------+-------------+--------+--------+-----
+ *
+ * Each game is a fixed-size header, the names of the black and white engines,
+ * and then one byte per move, in the order the moves were played:
+ *
+ * +-------------+------------+------------+-------+---------+
+ * | game header | black name | white name | moves | padding |
+ * +-------------+------------+------------+-------+---------+
+ *
+ * A move is the number of the square it was played on (8 * y + x), or
+ * GAMERECORD_PASS for a pass. Games are padded to a multiple of 4 bytes, so
+ * that every game header is aligned.
+ *
+ * Each game is appended with a single write(), so several processes (or the
+ * server's threads) can append to the same file. The reader maps the whole file
+ * and hands out pointers into it, so reading a game copies nothing.
+ */
+
+#define GAMERECORD_MAGIC   "OTHGAM1"
+#define GAMERECORD_VERSION 1
+
+// The move byte that stands for a pass.
+#define GAMERECORD_PASS 64
+
+// The result of a game whose moves stop before its end. The java wrapper never
+// sends the move that ends a game, so a game that the opponent finishes is
+// recorded without its last move by denyatbot (and by denyatbot-server, unless
+// the move is given with "end"), and its final disc difference is unknown.
+#define GAMERECORD_UNKNOWN_RESULT INT8_MIN
+
+typedef struct gamerecord_file_header_struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+} *GameRecordFileHeader;
+
+typedef struct gamerecord_header_struct
+{
+    // The size of the whole game, including this header and the padding.
+    uint32_t size;
+
+    // The final disc difference for black, counting any empty squares as the
+    // winner's (as in tournament scoring), or GAMERECORD_UNKNOWN_RESULT.
+    int8_t result;
+
+    // The number of moves, including passes.
+    uint8_t num_moves;
+
+    uint8_t black_name_length, white_name_length;
+
+    // Each side's clock at the start of the game (0 if the game was untimed),
+    // and the time each side used, in milliseconds. Time a side's engine did
+    // not report is 0.
+    uint32_t start_ms, black_ms, white_ms;
+} *GameRecordHeader;
+
+// A game that is being played, kept in memory until it is written out.
+class GameRecord {
+
+public:
+    string black_name, white_name;
+    uint32_t start_ms, black_ms, white_ms;
+    vector<uint8_t> moves;
+
+    GameRecord();
+
+    // Adds a move (or a pass, for nullptr) to the end of the game.
+    void add_move(Move *move);
+};
+
+class GameWriter {
+
+private:
+    int fd;
+
+public:
+    // Opens the file for appending, starting a new file if it is empty.
+    GameWriter(const char *path);
+    ~GameWriter();
+
+    bool is_open() { return fd >= 0; }
+
+    // Appends the game, working out its result by replaying it (the result is
+    // GAMERECORD_UNKNOWN_RESULT if the game is not over after its last move).
+    // Returns false if the game could not be written.
+    bool write(const GameRecord &game);
+};
+
+// A game in a mapped file.
+typedef struct game_view_struct
+{
+    GameRecordHeader header;
+    const char *black_name, *white_name;
+    const uint8_t *moves;
+} *GameView;
+
+class GameReader {
+
+private:
+    const char *data;
+    size_t size, offset;
+
+public:
+    // Maps the whole file.
+    GameReader(const char *path);
+    ~GameReader();
+
+    bool is_open() { return data != nullptr; }
+
+    // Points game at the next game in the file, returning false if there are
+    // no more (a partially-written game at the end of the file is ignored).
+    bool next(GameView game);
+
+    // Goes back to the first game.
+    void rewind();
+};
+
+// Regenerates the positions of a game, one move at a time.
+class GameReplay {
+
+private:
+    struct board_struct board;
+    Side side;
+    const uint8_t *move, *end;
+
+public:
+    // Starts at the initial position, with black to move.
+    GameReplay(GameView game);
+
+    // The current position, and the side to move in it.
+    Board get_board() { return &board; }
+    Side get_side() { return side; }
+
+    // The next move to be played (a square number or GAMERECORD_PASS), or -1 if
+    // the game is over.
+    int next_move() { return (move < end) ? *move : -1; }
+
+    // Plays the next move, returning false if the game is over (or the next
+    // move is not a valid square).
+    bool step();
+};
+
+// Returns the final disc difference for black in the given position, counting
+// any empty squares as the winner's.
+int8_t game_result(Board board);
+
+// Returns true if neither side can move in the given position.
+bool game_over(Board board);
+
+#endif
@@ -0,0 +1,234 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "board.hpp"
+using namespace std;
+
+/*
+ * Measures the round-trip latency of a player program, the way the java
+ * wrapper sees it: the time from sending the opponent's move down the pipe to
+ * reading the whole answer back, for every move of a number of games against
+ * a fake opponent that plays random legal moves.
+ *
+ * Usage: latency games player [--option=value ...]
+ *
+ * The player is started once per game (playing black, then white, in turn)
+ * with the given options; to measure the I/O rather than the search, give it a
+ * shallow search and a small table, e.g.
+ *
+ *   latency 100 ./denyatbot --depth=1 --endgame=0 --hash=1
+ *
+ * The median, mean, 99th percentile, and worst round trips are printed.
+ */
+
+// A running player program, with a pipe each way.
+struct PlayerProcess
+{
+    pid_t pid;
+    int to_player, from_player;
+};
+
+static bool start_player(
+    PlayerProcess *process, const vector<string> &args, Side side
+    )
+{
+    int to_player[2], from_player[2];
+    if (pipe(to_player) || pipe(from_player))
+        return false;
+
+    process->pid = fork();
+    if (process->pid < 0)
+        return false;
+
+    if (process->pid == 0)
+    {
+        dup2(to_player[0], STDIN_FILENO);
+        dup2(from_player[1], STDOUT_FILENO);
+        close(to_player[0]);
+        close(to_player[1]);
+        close(from_player[0]);
+        close(from_player[1]);
+
+        vector<char *> argv;
+        for (size_t i = 0; i < args.size(); i++)
+            argv.push_back((char *) args[i].c_str());
+        argv.push_back((char *) (side == BLACK ? "Black" : "White"));
+        argv.push_back(nullptr);
+
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(to_player[0]);
+    close(from_player[1]);
+    process->to_player = to_player[1];
+    process->from_player = from_player[0];
+    return true;
+}
+
+// Reads one line from the player (without the newline), returning false if
+// the player has exited.
+static bool read_line(int fd, string *line)
+{
+    line->clear();
+    char c;
+
+    while (true)
+    {
+        ssize_t length = read(fd, &c, 1);
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            return false;
+        if (c == '\n')
+            return true;
+        *line += c;
+    }
+}
+
+static bool write_line(int fd, const string &line)
+{
+    return write(fd, line.data(), line.size()) == (ssize_t) line.size();
+}
+
+// Plays one game against the player, adding the round trip of every one of
+// its moves to round_trips (in microseconds). Returns false if the player
+// misbehaves.
+static bool play_game(
+    const vector<string> &args, Side player_side, mt19937_64 &random,
+    vector<double> &round_trips
+    )
+{
+    PlayerProcess process;
+    if (!start_player(&process, args, player_side))
+        return false;
+
+    string line;
+    bool ok = read_line(process.from_player, &line) && line == "Init done";
+
+    struct board_struct board;
+    set_bits(&board, 0x0000001008000000, 0x0000000810000000);
+    Side side = BLACK;
+
+    // The move to send the player next ("-1 -1" for none).
+    int last_x = -1, last_y = -1;
+
+    while (ok)
+    {
+        uint64_t moves = move_bitboard(board.bits[side], board.bits[!side]);
+
+        if (!moves && !move_bitboard(board.bits[!side], board.bits[side]))
+            break;
+
+        if (side != player_side)
+        {
+            // Play a random move, or pass.
+            last_x = last_y = -1;
+
+            if (moves)
+            {
+                for (int i = random() % num_ones(moves); i > 0; i--)
+                    moves &= moves - 1;
+
+                uint8_t position = stone_position(moves & -moves);
+                add_stone(&board, side, moves & -moves);
+                last_x = position % 8;
+                last_y = position / 8;
+            }
+
+            side = !side;
+            continue;
+        }
+
+        // The player is asked even when it has to pass, as the java wrapper
+        // does.
+        string request = to_string(last_x) + " " + to_string(last_y) + " -1\n";
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        ok = write_line(process.to_player, request) &&
+        read_line(process.from_player, &line);
+        round_trips.push_back(chrono::duration<double, micro>(
+            chrono::steady_clock::now() - start
+            ).count());
+
+        int x, y;
+        if (!ok || sscanf(line.c_str(), "%d %d", &x, &y) != 2)
+        {
+            ok = false;
+            break;
+        }
+
+        if (x >= 0 && y >= 0)
+        {
+            uint64_t stone = new_stone(x, y);
+            if (!(moves & stone))
+            {
+                cerr << "illegal move " << x << " " << y << endl;
+                ok = false;
+                break;
+            }
+            add_stone(&board, side, stone);
+        }
+        else if (moves)
+        {
+            cerr << "passed with a legal move" << endl;
+            ok = false;
+            break;
+        }
+
+        side = !side;
+    }
+
+    // Closing the pipe ends the player's game.
+    close(process.to_player);
+    close(process.from_player);
+    int status;
+    waitpid(process.pid, &status, 0);
+
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "usage: " << argv[0] << " games player [--option=value ...]" <<
+        endl;
+        exit(-1);
+    }
+
+    int num_games = atoi(argv[1]);
+    vector<string> args(argv + 2, argv + argc);
+
+    mt19937_64 random(2016);
+    vector<double> round_trips;
+
+    for (int game = 0; game < num_games; game++)
+        if (!play_game(args, (game % 2) ? WHITE : BLACK, random, round_trips))
+        {
+            cerr << "game " << game << " failed" << endl;
+            exit(-1);
+        }
+
+    if (round_trips.empty())
+        return 0;
+
+    sort(round_trips.begin(), round_trips.end());
+
+    double total = 0;
+    for (size_t i = 0; i < round_trips.size(); i++)
+        total += round_trips[i];
+
+    cout << round_trips.size() << " moves: median " <<
+    round_trips[round_trips.size() / 2] << " us, mean " <<
+    total / round_trips.size() << " us, 99th percentile " <<
+    round_trips[round_trips.size() * 99 / 100] << " us, worst " <<
+    round_trips.back() << " us" << endl;
+
+    return 0;
+}
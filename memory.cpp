@@ -0,0 +1,224 @@
+#include "memory.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+using namespace std;
+
+// The memory policy that spreads pages evenly over a set of NUMA nodes (from
+// linux/mempolicy.h, which is not always installed).
+#define MPOL_INTERLEAVE 3
+
+// The amount of memory populated by each call to madvise(), so that a
+// background thread can be stopped quickly.
+#define POPULATE_CHUNK (64UL << 20)
+
+// The background threads populating a block of memory.
+typedef struct populate_job_struct
+{
+    char *memory;
+    size_t bytes;
+    atomic<bool> stop;
+
+    // Cleared if a page could not be populated, in which case wait_large()
+    // touches every page instead.
+    atomic<bool> populated;
+
+    vector<thread> threads;
+} *PopulateJob;
+
+// Every block of memory that has been allocated and not yet freed.
+static mutex jobs_lock;
+static vector<PopulateJob> jobs;
+
+// Returns the number of NUMA nodes in this machine (at most 64).
+static int num_numa_nodes()
+{
+    int nodes = 0;
+    char path[64];
+
+    while (nodes < 64)
+    {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", nodes);
+        if (access(path, F_OK))
+            break;
+        nodes++;
+    }
+
+    return nodes;
+}
+
+// Faults in every page in the given slice of memory, unless the job is stopped
+// first. If MADV_POPULATE_WRITE is not supported (before Linux 5.14), the pages
+// are left to be faulted in on first use, or by wait_large().
+static void populate_pages(PopulateJob job, char *memory, size_t bytes)
+{
+    for (
+        size_t offset = 0;
+        offset < bytes && !job->stop.load(memory_order_relaxed);
+        offset += POPULATE_CHUNK
+        )
+    {
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(
+            memory + offset,
+            (bytes - offset < POPULATE_CHUNK) ? bytes - offset : POPULATE_CHUNK,
+            MADV_POPULATE_WRITE
+            ))
+#endif
+        {
+            job->populated = false;
+            break;
+        }
+    }
+}
+
+void *alloc_large(size_t bytes, int threads)
+{
+    bytes = round_to_huge_pages(bytes);
+
+    void *memory = mmap(
+        nullptr, bytes, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+        );
+
+    if (memory == MAP_FAILED)
+    {
+        // Map one extra huge page, so that a huge-page-aligned region can be
+        // cut out of the middle, and unmap the unused ends.
+        char *unaligned = (char *) mmap(
+            nullptr, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+            );
+
+        if (unaligned == MAP_FAILED)
+            return nullptr;
+
+        char *aligned = (char *) round_to_huge_pages((uintptr_t) unaligned);
+
+        if (aligned > unaligned)
+            munmap(unaligned, aligned - unaligned);
+        munmap(aligned + bytes, unaligned + HUGE_PAGE_SIZE - aligned);
+
+        memory = aligned;
+
+#ifdef MADV_HUGEPAGE
+        madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    int nodes = num_numa_nodes();
+    if (threads > 1 && nodes > 1)
+    {
+        unsigned long nodemask = (nodes == 64) ? ~0UL : (1UL << nodes) - 1;
+        syscall(
+            SYS_mbind, memory, bytes, MPOL_INTERLEAVE, &nodemask, nodes + 1, 0
+            );
+    }
+
+    // Each thread populates one contiguous, huge-page-aligned slice.
+    if (threads < 1)
+        threads = 1;
+
+    size_t slice = round_to_huge_pages(bytes / threads);
+
+    PopulateJob job = new struct populate_job_struct;
+    job->memory = (char *) memory;
+    job->bytes = bytes;
+    job->stop = false;
+    job->populated = true;
+
+    for (size_t offset = 0; offset < bytes; offset += slice)
+        job->threads.push_back(thread(
+            populate_pages, job, (char *) memory + offset,
+            (bytes - offset < slice) ? bytes - offset : slice
+            ));
+
+    lock_guard<mutex> guard(jobs_lock);
+    jobs.push_back(job);
+
+    return memory;
+}
+
+void wait_large(void *memory)
+{
+    PopulateJob job = nullptr;
+
+    {
+        lock_guard<mutex> guard(jobs_lock);
+        for (size_t i = 0; i < jobs.size(); i++)
+            if (jobs[i]->memory == memory)
+                job = jobs[i];
+    }
+
+    // The job's threads are only joined here and in free_large(), which must
+    // not be called for the same memory at the same time.
+    if (!job)
+        return;
+
+    for (size_t i = 0; i < job->threads.size(); i++)
+        if (job->threads[i].joinable())
+            job->threads[i].join();
+
+    // If the pages could not be populated, fault them in by writing to one
+    // byte of each. The byte is written back unchanged, which is safe since the
+    // memory is not in use yet.
+    if (!job->populated)
+    {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        volatile char *memory = job->memory;
+
+        for (size_t offset = 0; offset < job->bytes; offset += page_size)
+            memory[offset] = memory[offset];
+
+        job->populated = true;
+    }
+}
+
+void free_large(void *memory, size_t bytes)
+{
+    PopulateJob job = nullptr;
+
+    {
+        lock_guard<mutex> guard(jobs_lock);
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            if (jobs[i]->memory == memory)
+            {
+                job = jobs[i];
+                jobs.erase(jobs.begin() + i);
+                break;
+            }
+        }
+    }
+
+    if (job)
+    {
+        job->stop = true;
+        for (size_t i = 0; i < job->threads.size(); i++)
+            if (job->threads[i].joinable())
+                job->threads[i].join();
+        delete job;
+    }
+
+    munmap(memory, round_to_huge_pages(bytes));
+}
+
+size_t resident_bytes()
+{
+    // The second field of /proc/self/statm is the number of resident pages.
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0;
+
+    unsigned long size, resident;
+    int num_read = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+
+    return (num_read == 2) ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
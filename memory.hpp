@@ -0,0 +1,55 @@
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <cstddef>
+
+// The size of a huge page on x86-64.
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+// The size of a regular page.
+#define SMALL_PAGE_SIZE (4UL << 10)
+
+/*
+ * Large, randomly-accessed arrays (like the transposition table) are backed by
+ * huge pages wherever possible, since with 4 KB pages nearly every access to
+ * them would also miss the TLB. Explicit huge pages (from hugetlbfs) are tried
+ * first; if none are reserved, the memory is mapped normally and marked with
+ * MADV_HUGEPAGE so that the kernel backs it with transparent huge pages.
+ *
+ * On machines with several NUMA nodes, the pages are interleaved across all the
+ * nodes when more than one thread will use them, so that no single memory
+ * controller serves every probe.
+ *
+ * The memory is zero-filled, and is returned as soon as it is mapped. Its pages
+ * are then faulted in by the given number of background threads (with
+ * MADV_POPULATE_WRITE, which never changes the contents of a page, so the
+ * memory can be used at the same time), and any page that is used before its
+ * turn is simply faulted in on first use. This way, allocating even a very
+ * large table takes almost no time.
+ */
+
+// Rounds the number of bytes up to a whole number of huge pages, which is the
+// amount of memory that alloc_large() actually maps for them.
+static inline size_t round_to_huge_pages(size_t bytes)
+{
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+// Allocates the given number of bytes, returning nullptr on failure.
+void *alloc_large(size_t bytes, int threads);
+
+// Waits until every page of memory returned by alloc_large() has been faulted
+// in, so that the memory is resident before it is needed. If the kernel could
+// not populate the pages, they are touched one by one, so this must be called
+// before the memory is first used.
+void wait_large(void *memory);
+
+// Frees memory returned by alloc_large(), first stopping its background
+// threads.
+void free_large(void *memory, size_t bytes);
+
+// Returns the number of bytes of this process's memory that are resident, or 0
+// if that cannot be found.
+size_t resident_bytes();
+
+#endif
@@ -0,0 +1,264 @@
+#include "options.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+
+EngineOptions::EngineOptions()
+{
+    hash_mb = DEFAULT_HASH_MB;
+    memory_mb = DEFAULT_MEMORY_MB;
+    threads = DEFAULT_THREADS;
+    solve_threads = DEFAULT_SOLVE_THREADS;
+    endgame_hash_mb = DEFAULT_ENDGAME_HASH_MB;
+    max_depth = DEFAULT_MAX_DEPTH;
+    move_time_ms = DEFAULT_MOVE_TIME_MS;
+    endgame_empties = DEFAULT_ENDGAME_EMPTIES;
+    multipv = DEFAULT_MULTIPV;
+
+    lmr = DEFAULT_LMR;
+    lmr_min_depth = DEFAULT_LMR_MIN_DEPTH;
+    lmr_min_moves = DEFAULT_LMR_MIN_MOVES;
+    lmr_base = DEFAULT_LMR_BASE;
+    lmr_divisor = DEFAULT_LMR_DIVISOR;
+
+    stoneimb_mult_start  = STONEIMB_MULT_START;
+    stoneimb_mult_end    = STONEIMB_MULT_END;
+    mobility_mult_start  = MOBILITY_MULT_START;
+    pmobility_mult_start = PMOBILITY_MULT_START;
+    corners_mult_start   = CORNERS_MULT_START;
+    pcorners_mult_start  = PCORNERS_MULT_START;
+    safety_mult_start    = SAFETY_MULT_START;
+    parity_mult_end      = PARITY_MULT_END;
+
+    solvedb_file = DEFAULT_SOLVEDB_FILE;
+}
+
+// Parses a whole string as an integer between min and max.
+static bool parse_int(const string &value, long min, long max, long *result)
+{
+    char *end;
+    *result = strtol(value.c_str(), &end, 10);
+    return !value.empty() && *end == '\0' && *result >= min && *result <= max;
+}
+
+bool EngineOptions::set_option(const string &name, const string &value)
+{
+    long number;
+
+    if (name == "config" || name == "eval")
+        return load_file(value);
+
+    if (name == "solvedb")
+    {
+        solvedb_file = value;
+        return true;
+    }
+
+    if (name == "record")
+    {
+        record_file = value;
+        return true;
+    }
+
+    if (name == "hash")
+    {
+        if (!parse_int(value, 1, 1L << 20, &number))
+            return false;
+        hash_mb = number;
+        return true;
+    }
+
+    if (name == "memory")
+    {
+        if (!parse_int(value, 0, 1L << 20, &number))
+            return false;
+        memory_mb = number;
+        return true;
+    }
+
+    if (name == "threads")
+    {
+        if (!parse_int(value, 1, 256, &number))
+            return false;
+        threads = number;
+        return true;
+    }
+
+    if (name == "solve_threads")
+    {
+        if (!parse_int(value, 1, MAX_SOLVE_THREADS, &number))
+            return false;
+        solve_threads = number;
+        return true;
+    }
+
+    if (name == "endgame_hash")
+    {
+        if (!parse_int(value, 1, 1L << 20, &number))
+            return false;
+        endgame_hash_mb = number;
+        return true;
+    }
+
+    if (name == "depth")
+    {
+        if (!parse_int(value, 1, MAX_MAX_DEPTH, &number))
+            return false;
+        max_depth = number;
+        return true;
+    }
+
+    if (name == "movetime")
+    {
+        if (!parse_int(value, 0, INT32_MAX, &number))
+            return false;
+        move_time_ms = number;
+        return true;
+    }
+
+    if (name == "endgame")
+    {
+        if (!parse_int(value, 0, MAX_ENDGAME_EMPTIES, &number))
+            return false;
+        endgame_empties = number;
+        return true;
+    }
+
+    if (name == "multipv")
+    {
+        if (!parse_int(value, 1, MAX_MULTIPV, &number))
+            return false;
+        multipv = number;
+        return true;
+    }
+
+    if (name == "lmr")
+    {
+        if (!parse_int(value, 0, 1, &number))
+            return false;
+        lmr = number;
+        return true;
+    }
+
+    // Late move reduction parameters.
+    int *lmr_parameter =
+    (name == "lmr_min_depth") ? &lmr_min_depth :
+    (name == "lmr_min_moves") ? &lmr_min_moves :
+    (name == "lmr_base")      ? &lmr_base      : nullptr;
+
+    if (lmr_parameter)
+    {
+        if (!parse_int(value, 0, 10000, &number))
+            return false;
+        *lmr_parameter = number;
+        return true;
+    }
+
+    if (name == "lmr_divisor")
+    {
+        if (!parse_int(value, 1, 10000, &number))
+            return false;
+        lmr_divisor = number;
+        return true;
+    }
+
+    // Heuristic weights.
+    int32_t *weight =
+    (name == "stoneimb_start")  ? &stoneimb_mult_start  :
+    (name == "stoneimb_end")    ? &stoneimb_mult_end    :
+    (name == "mobility_start")  ? &mobility_mult_start  :
+    (name == "pmobility_start") ? &pmobility_mult_start :
+    (name == "corners_start")   ? &corners_mult_start   :
+    (name == "pcorners_start")  ? &pcorners_mult_start  :
+    (name == "safety_start")    ? &safety_mult_start    :
+    (name == "parity_end")      ? &parity_mult_end      : nullptr;
+
+    if (weight && parse_int(value, -100000, 100000, &number))
+    {
+        *weight = number;
+        return true;
+    }
+
+    return false;
+}
+
+// Removes whitespace from both ends of the string.
+static string trim(const string &s)
+{
+    size_t start = s.find_first_not_of(" \t\r"),
+    end = s.find_last_not_of(" \t\r");
+
+    return (start == string::npos) ? "" : s.substr(start, end - start + 1);
+}
+
+bool EngineOptions::load_file(const string &path)
+{
+    ifstream file(path.c_str());
+    if (!file)
+    {
+        cerr << "options: could not read " << path << endl;
+        return false;
+    }
+
+    string line;
+    int line_number = 0;
+
+    while (getline(file, line))
+    {
+        line_number++;
+        line = trim(line);
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t equals = line.find('=');
+        if (
+            equals == string::npos ||
+            !set_option(
+                trim(line.substr(0, equals)), trim(line.substr(equals + 1))
+                )
+            )
+        {
+            cerr << "options: invalid option at " << path << ":" <<
+            line_number << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int EngineOptions::parse_args(int argc, char *argv[])
+{
+    int num_positional = 0;
+
+    for (int i = 0; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--", 2))
+        {
+            argv[num_positional++] = argv[i];
+            continue;
+        }
+
+        string name = argv[i] + 2, value;
+        size_t equals = name.find('=');
+
+        if (equals != string::npos)
+        {
+            value = name.substr(equals + 1);
+            name = name.substr(0, equals);
+        }
+
+        else if (i + 1 < argc)
+            value = argv[++i];
+
+        if (!set_option(name, value))
+        {
+            cerr << "options: invalid value for --" << name << endl;
+            return -1;
+        }
+    }
+
+    return num_positional;
+}
@@ -0,0 +1,132 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+using namespace std;
+
+// The defaults for every engine option. Each can be overridden at runtime with
+// a command-line flag or a line in a config file (see set_option()).
+
+#define DEFAULT_HASH_MB         1536
+#define DEFAULT_MEMORY_MB       0
+#define DEFAULT_THREADS         1
+#define DEFAULT_SOLVE_THREADS   1
+#define DEFAULT_ENDGAME_HASH_MB 64
+#define DEFAULT_MAX_DEPTH       7
+#define DEFAULT_MOVE_TIME_MS    0
+#define DEFAULT_ENDGAME_EMPTIES 14
+#define DEFAULT_MULTIPV         1
+#define DEFAULT_SOLVEDB_FILE    ""
+
+// The solved-position database that selfplay and denyatbot-server use unless
+// --solvedb says otherwise. denyatbot only uses one when asked, since it is
+// started by the java wrapper in whatever directory that happens to be.
+#define SOLVEDB_FILE "denyatbot.sdb"
+
+#define DEFAULT_LMR           1
+#define DEFAULT_LMR_MIN_DEPTH 4
+#define DEFAULT_LMR_MIN_MOVES 3
+#define DEFAULT_LMR_BASE      0
+#define DEFAULT_LMR_DIVISOR   100
+
+#define STONEIMB_MULT_START  1000
+#define STONEIMB_MULT_END    4000
+#define MOBILITY_MULT_START  1200
+#define PMOBILITY_MULT_START 1200
+#define CORNERS_MULT_START   3000
+#define PCORNERS_MULT_START  1800
+#define SAFETY_MULT_START    2400
+#define PARITY_MULT_END      2000
+
+// The endgame solver needs one board per empty square, so the number of empty
+// squares at which it takes over is capped.
+#define MAX_ENDGAME_EMPTIES 24
+
+// The deepest fixed-depth search that the player can be configured for.
+#define MAX_MAX_DEPTH 32
+
+// The most threads that can solve a single endgame.
+#define MAX_SOLVE_THREADS 64
+
+// The most lines that a multi-PV search can report (no position has more legal
+// moves than this).
+#define MAX_MULTIPV 32
+
+class EngineOptions {
+
+public:
+    // The size of the transposition table and its pool of collision entries,
+    // in megabytes. The actual table is the largest power-of-two number of
+    // entries that fits.
+    size_t hash_mb;
+
+    // The most memory that the engine may use in all, in megabytes (0 means no
+    // limit). The tables are shrunk to fit whatever the rest of the engine
+    // needs, and all of it is allocated and faulted in up front (see Engine).
+    size_t memory_mb;
+
+    // The number of search threads.
+    int threads;
+
+    // The number of threads that solve each endgame, and the size of the
+    // endgame table that they share, in megabytes (the actual table is the
+    // largest power-of-two number of entries that fits).
+    int solve_threads;
+    size_t endgame_hash_mb;
+
+    // The depth of the midgame search.
+    int max_depth;
+
+    // The most time to spend on a single move, in milliseconds (0 means that
+    // only the time left in the game is taken into account).
+    int move_time_ms;
+
+    // The number of empty squares at which the endgame is solved exactly.
+    int endgame_empties;
+
+    // The number of best moves that an analysis search (see
+    // Player::start_search()) finds exact scores for; the player itself only
+    // ever needs the best one.
+    int multipv;
+
+    // Late move reductions: whether they are used, the shallowest depth and
+    // the first move (counting from 0, in search order) that can be reduced,
+    // and the base and divisor of the reduction formula (both in hundredths;
+    // see Engine).
+    bool lmr;
+    int lmr_min_depth, lmr_min_moves, lmr_base, lmr_divisor;
+
+    // The weights of the heuristic at the first and last turns.
+    int32_t stoneimb_mult_start, stoneimb_mult_end, mobility_mult_start,
+    pmobility_mult_start, corners_mult_start, pcorners_mult_start,
+    safety_mult_start, parity_mult_end;
+
+    // The solved-position database file (empty if none should be used).
+    string solvedb_file;
+
+    // The file that finished games are appended to (empty if games should not
+    // be recorded).
+    string record_file;
+
+    EngineOptions();
+
+    // Sets the option with the given name (without any leading dashes) to the
+    // given value, returning false if either one is invalid.
+    bool set_option(const string &name, const string &value);
+
+    // Reads options from a file containing one "name = value" pair per line.
+    // Blank lines and lines starting with '#' are ignored. Returns false if the
+    // file cannot be read or contains an invalid option.
+    bool load_file(const string &path);
+
+    // Reads options from command-line flags of the form --name=value or
+    // --name value. "--config FILE" reads a config file and "--eval FILE" reads
+    // a file of heuristic weights (in the config file format). Any arguments
+    // that are not flags are moved to the front of argv, and their number is
+    // returned; -1 is returned if a flag is invalid.
+    int parse_args(int argc, char *argv[]);
+};
+
+#endif
@@ -1,44 +1,77 @@
 #include "player.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 #include <iostream>
+#include <chrono>
 
 /*
  * Constructor for the player; initialize everything here. The side your AI is
  * on (BLACK or WHITE) is passed in as "side". The constructor must finish
  * within 30 seconds.
  */
-Player::Player(Side side) {
+Player::Player(Side side, const EngineOptions &options) {
+    engine = new Engine(options);
+    owns_engine = true;
+    init(side);
+}
+
+/*
+ * Constructor for a player that shares its engine with other players. Nothing
+ * but the player's board and search stacks is allocated, so this is fast.
+ */
+Player::Player(Side side, Engine *engine) {
+    this->engine = engine;
+    owns_engine = false;
+    init(side);
+}
+
+void Player::init(Side side) {
     this->side = side;
 
+    table = engine->table;
+    table_size = engine->table_size;
+    pool = &engine->pool;
+    solvedb = engine->solvedb;
+    weights = engine->weights;
+    reductions = engine->reductions;
+
+    max_depth = engine->options.max_depth;
+    endgame_empties = engine->options.endgame_empties;
+    move_time_ms = engine->options.move_time_ms;
+    multipv = engine->options.multipv;
+
+    board_stack = new struct board_struct[max_depth + 2];
+    movelist_stack = new struct movelist_struct[max_depth + 1];
+    stopping = false;
+    has_deadline = false;
+    best_so_far = 64;
+    solver = new EndgameSolver(
+        engine->endgame_table, engine->endgame_table_size, solvedb,
+        engine->options.solve_threads, &stopping
+        );
+
     board = board_stack;
     movelist = movelist_stack;
+    nodes = 0;
+    last_score = 0;
+    record = nullptr;
 
     set_bits(board, 0x0000001008000000, 0x0000000810000000);
-
-    table_size = MAX_TABLE_SIZE;
-    bool unsuccessful_alloc = true;
-
-    while (unsuccessful_alloc)
-    {
-        try {
-            table = new struct table_entry_struct[table_size];
-            unsuccessful_alloc = false;
-        }
-
-        catch (const bad_alloc&) {
-            table_size >>= 2;
-        }
-    }
 }
 
 /*
  * Destructor for the player.
  */
 Player::~Player() {
-    for (size_t i = 0; i < table_size; i++)
-        if (table[i].next)
-            delete table[i].next;
+    if (search_thread.joinable())
+        stop_search();
 
-    delete[] table;
+    delete solver;
+    delete[] board_stack;
+    delete[] movelist_stack;
+
+    if (owns_engine)
+        delete engine;
 }
 
 /*
@@ -55,34 +88,328 @@ Player::~Player() {
  * return nullptr.
  */
 Move *Player::doMove(Move *opponentsMove, int msLeft) {
+    Move move(-1, -1);
+
+    if (!play_move(opponentsMove, msLeft, &move))
+        return nullptr;
+
+    return new Move(move);
+}
+
+bool Player::play_move(Move *opponentsMove, int msLeft, Move *move) {
+    PROFILE_SCOPE(PROFILE_SEARCH);
+    TRACE_START();
+
+    chrono::steady_clock::time_point move_start = chrono::steady_clock::now();
+
+    if (record)
+    {
+        // A missing move is a pass, unless this is black's first move.
+        if (opponentsMove || side == WHITE || !record->moves.empty())
+            record->add_move(opponentsMove);
+
+        if (!record->start_ms && msLeft > 0)
+            record->start_ms = msLeft;
+    }
+
     if (opponentsMove)
         add_stone(board, !side, new_stone(opponentsMove->x, opponentsMove->y));
 
     get_moves(board, side, movelist);
 
     if (movelist->num_moves == 0)
-        return nullptr;
+        return record_move(nullptr, move_start);
+
+    uint64_t best_move = 0;
+
+    uint8_t num_empties =
+    64 - num_ones(board->bits[WHITE] | board->bits[BLACK]);
+
+    // Solve the endgame exactly once there are few enough empty squares left.
+    if (num_empties <= endgame_empties)
+        best_move = solve_root(&last_score);
+
+    else
+    {
+        int budget = time_budget(msLeft);
+
+        // Without a time limit, search straight to the maximum depth.
+        // Otherwise, deepen iteratively, and stop once the next iteration is
+        // unlikely to finish within the budget (each iteration takes several
+        // times longer than the one before it). An iteration that runs past
+        // the budget anyway is stopped, and the move of the last finished one
+        // is played; the first iteration is always finished, so that there is
+        // a move.
+        if (budget < 0)
+            best_move = search_root(max_depth, &last_score);
+
+        else
+        {
+            chrono::steady_clock::time_point start =
+            chrono::steady_clock::now();
+            deadline = start + chrono::milliseconds(budget);
+
+            for (uint8_t depth = 1; depth <= max_depth; depth++)
+            {
+                int32_t score;
+                uint64_t depth_move = search_root(depth, &score);
+
+                if (stopping.load(memory_order_relaxed))
+                    break;
+
+                best_move = depth_move;
+                last_score = score;
+                has_deadline = true;
+
+                if (
+                    chrono::duration_cast<chrono::milliseconds>(
+                        chrono::steady_clock::now() - start
+                        ).count() * 4 > budget
+                    )
+                    break;
+            }
+
+            has_deadline = false;
+            stopping = false;
+        }
+    }
+
+    add_stone(board, side, best_move);
+    uint8_t best_move_position = stone_position(best_move);
+    move->x = best_move_position % 8;
+    move->y = best_move_position / 8;
+
+    PROFILE_REPORT(cerr);
+    TRACE_DUMP(TRACE_FILE);
+    return record_move(move, move_start);
+}
+
+// Packs a move and its score into a single word for best_so_far.
+static inline uint64_t pack_best(uint64_t move, int32_t score)
+{
+    return (uint64_t) (uint32_t) score << 32 | stone_position(move);
+}
+
+Move *Player::unpack_best(uint64_t best, int32_t *score)
+{
+    uint8_t position = best & 0xFF;
+
+    if (score)
+        *score = (int32_t) (best >> 32);
+
+    return (position < 64) ? new Move(position % 8, position / 8) : nullptr;
+}
+
+void Player::start_search(SearchCallback callback)
+{
+    if (search_thread.joinable())
+        stop_search();
+
+    // Until the first iteration finishes, fall back on the first legal move.
+    get_moves(board, side, movelist);
+    best_so_far = movelist->num_moves ?
+    pack_best(get_move(movelist, 0), 0) : 64;
+
+    search_thread = thread(&Player::run_search, this, callback);
+}
+
+Move *Player::stop_search(int32_t *score)
+{
+    stopping = true;
+    Move *move = wait_search(score);
+    stopping = false;
+
+    return move;
+}
+
+Move *Player::wait_search(int32_t *score)
+{
+    if (search_thread.joinable())
+        search_thread.join();
+
+    return unpack_best(best_so_far, score);
+}
+
+Move *Player::get_best_so_far(int32_t *score)
+{
+    return unpack_best(best_so_far, score);
+}
 
-    TableEntry entry = get_entry(board, table, table_size);
+// Runs the search started with start_search(), on its own thread.
+void Player::run_search(SearchCallback callback)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint64_t start_nodes = nodes;
+
+    if (movelist->num_moves == 0)
+        return;
+
+    uint8_t num_empties =
+    64 - num_ones(board->bits[WHITE] | board->bits[BLACK]);
+
+    struct search_info_struct info;
+    info.solved = num_empties <= endgame_empties;
+
+    // The moves of the best lines and their scores, best first.
+    uint64_t moves[MAX_MULTIPV];
+    int32_t scores[MAX_MULTIPV];
+
+    // An endgame is solved in a single iteration.
+    for (
+        uint8_t depth = info.solved ? num_empties : 1;
+        depth <= (info.solved ? num_empties : max_depth);
+        depth++
+        )
+    {
+        if (info.solved)
+        {
+            moves[0] = solve_root(&scores[0]);
+            info.num_lines = 1;
+        }
+
+        else if (multipv > 1)
+            info.num_lines =
+            search_root_multipv(depth, multipv, moves, scores);
+
+        else
+        {
+            moves[0] = search_root(depth, &scores[0]);
+            info.num_lines = 1;
+        }
+
+        // An iteration that was cut short has no result.
+        if (stopping.load(memory_order_relaxed))
+            return;
+
+        best_so_far = pack_best(moves[0], scores[0]);
+
+        info.depth = depth;
+        for (size_t i = 0; i < info.num_lines; i++)
+        {
+            info.lines[i].score = scores[i];
+            info.lines[i].pv_length = get_pv(
+                moves[i], info.solved ? MAX_PV_LENGTH : depth + 1,
+                info.lines[i].pv
+                );
+        }
+        info.nodes = nodes - start_nodes;
+        info.ms = chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now() - start
+            ).count();
+
+        callback(info);
+    }
+}
+
+// Follows the best moves stored in the tables from the current position,
+// starting with the given move, until one is missing or illegal (or a side has
+// to pass), and stores up to max_length of them in pv as square numbers.
+// Returns the number of moves stored.
+size_t Player::get_pv(uint64_t move, size_t max_length, uint8_t *pv)
+{
+    struct board_struct cur_board = *board;
+    Side cur_side = side;
+    size_t length = 0;
+
+    if (max_length > MAX_PV_LENGTH)
+        max_length = MAX_PV_LENGTH;
+
+    while (move && length < max_length)
+    {
+        pv[length++] = stone_position(move);
+        add_stone(&cur_board, cur_side, move);
+        cur_side = !cur_side;
+
+        // The endgame table only holds positions that were solved, and the
+        // transposition table only those that were searched.
+        if (
+            64 - num_ones(cur_board.bits[WHITE] | cur_board.bits[BLACK]) <=
+            endgame_empties
+            )
+            move = solver->table_move(&cur_board, cur_side);
+        else
+        {
+            TableEntry entry = find_entry(&cur_board, table, table_size);
+            move = entry ? entry->best_move : 0;
+        }
+
+        move &= move_bitboard(
+            cur_board.bits[cur_side], cur_board.bits[!cur_side]
+            );
+    }
+
+    return length;
+}
+
+// Adds this side's move (or pass, for nullptr) and the time it took to the
+// record of the game, if there is one, and returns false for a pass.
+bool Player::record_move(Move *move, chrono::steady_clock::time_point start)
+{
+    if (record)
+    {
+        record->add_move(move);
+
+        uint32_t ms = chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now() - start
+            ).count();
+
+        if (side == BLACK)
+            record->black_ms += ms;
+        else
+            record->white_ms += ms;
+    }
+
+    return move != nullptr;
+}
+
+// Returns the number of milliseconds that can be spent on this move, or -1 if
+// there is no time limit.
+int Player::time_budget(int msLeft)
+{
+    int budget = -1;
+
+    // Spread the time left evenly over the moves that this side has left.
+    if (msLeft > 0)
+        budget = msLeft /
+        ((65 - num_ones(board->bits[WHITE] | board->bits[BLACK])) / 2);
+
+    if (move_time_ms > 0 && (budget < 0 || move_time_ms < budget))
+        budget = move_time_ms;
+
+    return budget;
+}
+
+// Finds the best move for this player with a search of the given depth, storing
+// its score in score.
+uint64_t Player::search_root(uint8_t depth, int32_t *score)
+{
+    TableEntry entry = get_entry(board, table, table_size, pool);
     if (entry->in_use)
         sort_moves(movelist, entry);
 
     uint64_t best_move = 0,
     move;
 
-    int32_t alpha = INT32_MIN,
+    // The bounds of a full window are kept symmetric, since -INT32_MIN
+    // overflows: a child searched with INT32_MIN as its alpha would pass it
+    // back to its own children as their beta, and they would cut off after
+    // their first move.
+    int32_t alpha = -INT32_MAX,
     move_score;
 
+    TRACE_ENTER(alpha);
+
     for (size_t i = 0; i < movelist->num_moves; i++)
     {
         move = get_move(movelist, i);
-        add_stone_copy(board, side, move);
+        add_stone_copy(board, side, move, get_flips(movelist, i));
+        update_odd_squares(board, move);
 
         // Run negascout for the first move with a full search interval.
         if (i == 0)
             move_score = -negascout(
                 board + 1, movelist + 1, !side,
-                INT32_MIN, INT32_MAX, MAXDEPTH
+                -INT32_MAX, INT32_MAX, depth
                 );
 
         // Run negascout for subsequent moves with an empty search interval. If
@@ -93,13 +420,13 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
         {
             move_score = -negascout(
                 board + 1, movelist + 1, !side,
-                -alpha - 1, -alpha, MAXDEPTH
+                -alpha - 1, -alpha, depth
                 );
 
             if (move_score > alpha)
                 move_score = -negascout(
                     board + 1, movelist + 1, !side,
-                    INT32_MIN, -move_score, MAXDEPTH
+                    -INT32_MAX, -move_score, depth
                     );
         }
 
@@ -107,12 +434,92 @@ Move *Player::doMove(Move *opponentsMove, int msLeft) {
         {
             alpha = move_score;
             best_move = move;
+            TRACE_BEST(i);
         }
     }
 
-    add_stone(board, side, best_move);
-    uint8_t best_move_position = stone_position(best_move);
-    return new Move(best_move_position % 8, best_move_position / 8);
+    // The root's children are searched to the given depth, so the root itself
+    // is one ply deeper.
+    *score = TRACE_RETURN(
+        board->hash, 0, depth + 1, INT32_MAX, alpha, movelist->num_moves,
+        TRACE_ROOT
+        );
+    return best_move;
+}
+
+// Finds the num_lines best moves for this player (or all of its moves, if it
+// has fewer) with searches of the given depth, storing them in best_moves and
+// their exact scores in scores, best first. Returns the number of moves stored.
+size_t Player::search_root_multipv(
+    uint8_t depth, size_t num_lines, uint64_t *best_moves, int32_t *scores
+    )
+{
+    // The best lines of the last iteration are moved to the front of the
+    // movelist, so the table entry of the root is only used the first time.
+    TableEntry entry = get_entry(board, table, table_size, pool);
+    if (entry->in_use && depth == 1)
+        sort_moves(movelist, entry);
+
+    size_t num_found = 0;
+
+    for (size_t i = 0; i < movelist->num_moves; i++)
+    {
+        uint64_t move = get_move(movelist, i);
+        add_stone_copy(board, side, move, get_flips(movelist, i));
+        update_odd_squares(board, move);
+
+        int32_t move_score;
+
+        // Until num_lines moves have been searched, every move gets a full
+        // window. After that, a move only needs an exact score if it beats the
+        // worst of the best lines, which an empty window around that line's
+        // score shows; if it does, the move is searched again with a window
+        // that starts at that score.
+        if (num_found < num_lines)
+            move_score = -negascout(
+                board + 1, movelist + 1, !side,
+                -INT32_MAX, INT32_MAX, depth
+                );
+
+        else
+        {
+            int32_t worst = scores[num_found - 1];
+
+            move_score = -negascout(
+                board + 1, movelist + 1, !side,
+                -worst - 1, -worst, depth
+                );
+
+            if (move_score <= worst)
+                continue;
+
+            move_score = -negascout(
+                board + 1, movelist + 1, !side,
+                -INT32_MAX, -worst, depth
+                );
+
+            if (move_score <= worst)
+                continue;
+        }
+
+        // Insert the move into the best lines, dropping the worst one if they
+        // are full.
+        size_t j = (num_found < num_lines) ? num_found++ : num_found - 1;
+        for (; j > 0 && scores[j - 1] < move_score; j--)
+        {
+            best_moves[j] = best_moves[j - 1];
+            scores[j] = scores[j - 1];
+        }
+        best_moves[j] = move;
+        scores[j] = move_score;
+    }
+
+    // Move the best lines to the front of the movelist, best first, for the
+    // next iteration.
+    for (size_t j = num_found; j-- > 0; )
+        move_to_front(movelist, best_moves[j]);
+
+    return num_found;
 }
 
 int32_t Player::negascout(
@@ -120,22 +527,126 @@ int32_t Player::negascout(
     int32_t alpha, int32_t beta, uint8_t depth
     )
 {
-    TableEntry entry = get_entry(cur_board, table, table_size);
-    if (entry->in_use && entry->depth == depth)
-        return entry->score;
+    bool pv = beta > alpha + 1;
+
+    if (cur_side == BLACK)
+        return pv ?
+        search_node<BLACK, true>(cur_board, cur_movelist, alpha, beta, depth) :
+        search_node<BLACK, false>(cur_board, cur_movelist, alpha, beta, depth);
+
+    return pv ?
+    search_node<WHITE, true>(cur_board, cur_movelist, alpha, beta, depth) :
+    search_node<WHITE, false>(cur_board, cur_movelist, alpha, beta, depth);
+}
 
+// The body of negascout(), specialized for the side to move, and for whether
+// the window may be wider than an empty one (pv). A node with an empty window
+// keeps it to the end, since any move that raises alpha cuts it off, so such
+// nodes never search a move again with a wider window, always allow late move
+// reductions, and never store their scores; with pv, all of this is decided
+// from the window as it narrows.
+template <Side cur_side, bool pv>
+int32_t Player::search_node(
+    Board cur_board, Movelist cur_movelist, int32_t alpha, int32_t beta,
+    uint8_t depth
+    )
+{
+    const Side other_side = (Side) (BLACK - cur_side);
+
+    if (stopping.load(memory_order_relaxed))
+        return 0;
+
+    nodes++;
+
+    if (
+        has_deadline && !(nodes & (DEADLINE_CHECK_NODES - 1)) &&
+        chrono::steady_clock::now() >= deadline
+        )
+    {
+        stopping = true;
+        return 0;
+    }
+
+    TRACE_ENTER(alpha);
+
+    // Scores are only stored in the table for depths of at least 1, so there is
+    // no need to look up a leaf (and wait for its entry to be loaded). The
+    // heuristic is antisymmetric (each of its terms is a difference between
+    // the sides), so scoring the position for the side to move gives the
+    // negated score for this player without a branch.
     if (depth == 0)
-        return (entry->score = (cur_side == side) ?
-        heuristic(cur_board) : -heuristic(cur_board));
+        return TRACE_RETURN(
+            cur_board->hash, cur_board - board_stack, depth, beta,
+            evaluate(
+                get_stones(cur_board, cur_side),
+                get_stones(cur_board, other_side), cur_board->odd_squares,
+                weights
+                ),
+            0, TRACE_LEAF
+            );
+
+    TableEntry entry = get_entry(cur_board, table, table_size, pool);
+    if (entry->in_use && entry->depth == depth)
+        return TRACE_RETURN(
+            cur_board->hash, cur_board - board_stack, depth, beta,
+            entry->score, 0, TRACE_TABLE
+            );
 
     get_moves(cur_board, cur_side, cur_movelist);
 
     if (cur_movelist->num_moves == 0)
-        return (entry->score = (cur_side == side) ?
-        heuristic(cur_board) : -heuristic(cur_board));
+        return TRACE_RETURN(
+            cur_board->hash, cur_board - board_stack, depth, beta,
+            (entry->score = evaluate(
+                get_stones(cur_board, cur_side),
+                get_stones(cur_board, other_side), cur_board->odd_squares,
+                weights
+                )),
+            0, TRACE_NO_MOVES
+            );
+
+    // Start loading the table entries of all the children at once, so that
+    // their cache misses overlap with each other and with the work done here,
+    // instead of each one stalling the search when the child is reached.
+    if (depth >= 2)
+        for (size_t i = 0; i < cur_movelist->num_moves; i++)
+            prefetch_entry(
+                child_hash(
+                    cur_board, cur_side, get_move(cur_movelist, i),
+                    get_flips(cur_movelist, i)
+                    ),
+                table, table_size
+                );
 
-    if (entry->in_use)
-        sort_moves(movelist, entry);
+    // Enhanced transposition cutoff: if any child is already in the table with
+    // a score that proves this node is too good for the other side, there is
+    // no need to search any of the children.
+    if (depth >= ETC_MIN_DEPTH)
+        for (size_t i = 0; i < cur_movelist->num_moves; i++)
+        {
+            add_stone_copy(
+                cur_board, cur_side, get_move(cur_movelist, i),
+                get_flips(cur_movelist, i)
+                );
+            TableEntry child = find_entry(cur_board + 1, table, table_size);
+
+            if (
+                child && child->in_use && child->depth == depth - 1 &&
+                -child->score >= beta
+                )
+                return TRACE_RETURN(
+                    cur_board->hash, cur_board - board_stack, depth, beta,
+                    -child->score, cur_movelist->num_moves, TRACE_ETC
+                    );
+        }
+
+    // Search the table's best moves first. Without them, search the moves that
+    // leave the other side with the fewest replies first, since those moves
+    // tend to be good and their subtrees tend to be small.
+    if (entry->best_move)
+        sort_moves(cur_movelist, entry);
+    else if (depth >= FASTEST_FIRST_MIN_DEPTH)
+        sort_moves_fastest_first(cur_board, cur_side, cur_movelist);
 
     uint64_t best_move = 0, second_best_move = 0, third_best_move = 0,
     move;
@@ -145,29 +656,45 @@ int32_t Player::negascout(
     for (size_t i = 0; i < cur_movelist->num_moves; i++)
     {
         move = get_move(cur_movelist, i);
-        add_stone_copy(cur_board, cur_side, move);
+        add_stone_copy(cur_board, cur_side, move, get_flips(cur_movelist, i));
+        update_odd_squares(cur_board, move);
 
         // Run negascout for the first move with a full search interval.
         if (i == 0)
-            move_score = -negascout(
-                cur_board + 1, cur_movelist + 1, !cur_side,
-                -beta, -alpha, depth - 1
+            move_score = -search_node<other_side, pv>(
+                cur_board + 1, cur_movelist + 1, -beta, -alpha, depth - 1
                 );
 
         // Run negascout for subsequent moves with an empty search interval. If
         // the move score with an empty search interval is above the max-
         // player's highest score and below the min-player's lowest score, rerun
         // negascout with a full search interval.
+        //
+        // Away from the principal variation, late moves are rarely best, so
+        // they are searched to a reduced depth first (except for corners,
+        // which are too often best to be treated as late moves). A reduced
+        // move that turns out to be above the max-player's highest score is
+        // searched again to the full depth before it is trusted.
         else
         {
-            move_score = -negascout(
-                cur_board + 1, cur_movelist + 1, !cur_side,
-                -alpha - 1, -alpha, depth - 1
+            uint8_t reduction =
+            ((!pv || beta == alpha + 1) && !(move & CORNERS)) ?
+            reductions[depth][i] : 0;
+
+            move_score = -search_node<other_side, false>(
+                cur_board + 1, cur_movelist + 1,
+                -alpha - 1, -alpha, depth - 1 - reduction
                 );
 
-            if (move_score > alpha && move_score < beta)
-                move_score = -negascout(
-                    cur_board + 1, cur_movelist + 1, !cur_side,
+            if (reduction && move_score > alpha)
+                move_score = -search_node<other_side, false>(
+                    cur_board + 1, cur_movelist + 1,
+                    -alpha - 1, -alpha, depth - 1
+                    );
+
+            if (pv && move_score > alpha && move_score < beta)
+                move_score = -search_node<other_side, true>(
+                    cur_board + 1, cur_movelist + 1,
                     -beta, -move_score, depth - 1
                     );
         }
@@ -178,6 +705,7 @@ int32_t Player::negascout(
             third_best_move = second_best_move;
             second_best_move = best_move;
             best_move = move;
+            TRACE_BEST(i);
 
             // If the lower bound has reached the upper bound, the remaining
             // moves can be ignored.
@@ -186,8 +714,16 @@ int32_t Player::negascout(
         }
     }
 
-    if (alpha < beta && beta - alpha > 1)
+    // The scores of a stopped search are meaningless, so they are not stored.
+    if (stopping.load(memory_order_relaxed))
+        return 0;
+
+    if (pv && beta > alpha + 1)
     {
+        // The entry may have been taken over by another board (from deeper in
+        // this search, or from another thread) since it was retrieved.
+        entry->bits[WHITE] = cur_board->bits[WHITE];
+        entry->bits[BLACK] = cur_board->bits[BLACK];
         entry->in_use = true;
         entry->depth = depth;
         entry->score = alpha;
@@ -197,87 +733,87 @@ int32_t Player::negascout(
     entry->second_best_move = second_best_move;
     entry->third_best_move = third_best_move;
 
-    return alpha;
+    return TRACE_RETURN(
+        cur_board->hash, cur_board - board_stack, depth, beta, alpha,
+        cur_movelist->num_moves, TRACE_SEARCHED
+        );
 }
 
-const int32_t STONEIMB_MULT_CHANGE  =
-(STONEIMB_MULT_END - STONEIMB_MULT_START) / 60;
-const int32_t MOBILITY_MULT_CHANGE  = -MOBILITY_MULT_START  / 60;
-const int32_t PMOBILITY_MULT_CHANGE = -PMOBILITY_MULT_START / 60;
-const int32_t CORNERS_MULT_CHANGE   = -CORNERS_MULT_START   / 60;
-const int32_t PCORNERS_MULT_CHANGE  = -PCORNERS_MULT_START  / 60;
-const int32_t SAFETY_MULT_CHANGE    = -SAFETY_MULT_START    / 60;
-
 // Calculates the score for a given board.
 int32_t Player::heuristic(Board cur_board)
 {
-    uint64_t this_stones    = get_stones(cur_board, side),
-    other_stones            = get_stones(cur_board, !side);
-
-    uint8_t num_this_stones = num_ones(this_stones),
-    num_other_stones        = num_ones(other_stones),
-    turn                    = num_this_stones + num_other_stones - 4;
-
-    // On the last turn, the only part of the heuristic that matters is the
-    // stone imbalance, so all further calculations can be avoided.
-    if (turn == 60)
-        return STONEIMB_MULT_END *
-        (num_this_stones - num_other_stones) /
-        (num_this_stones + num_other_stones);
-
-    uint64_t this_moves     = move_bitboard(this_stones, other_stones),
-    other_moves             = move_bitboard(other_stones, this_stones);
-
-    uint8_t num_this_moves  = num_ones(this_moves),
-    num_other_moves         = num_ones(other_moves),
-    num_this_spaces         = num_spaces(this_stones, other_stones),
-    num_other_spaces        = num_spaces(other_stones, this_stones),
-    num_this_corners        = num_corners(this_stones),
-    num_other_corners       = num_corners(other_stones),
-    num_this_corner_moves   = num_corners(this_moves),
-    num_other_corner_moves  = num_corners(other_moves),
-    num_this_safe           = (num_other_moves) ?
-    num_safe(this_stones, other_stones, other_moves) : num_this_stones,
-    num_other_safe          = (num_this_moves) ?
-    num_safe(other_stones, this_stones, this_moves) : num_other_stones;
-
-    // STONE IMBALANCE
-    // There is no need to check whether num_this_stones + num_other_stones is
-    // nonzero, since there will always be at least 4 stones on the board.
-    int32_t score = (STONEIMB_MULT_START + STONEIMB_MULT_CHANGE * turn) *
-    (num_this_stones - num_other_stones) /
-    (num_this_stones + num_other_stones);
-
-    // MOBILITY
-    if (num_this_moves + num_other_moves)
-        score += (MOBILITY_MULT_START + MOBILITY_MULT_CHANGE * turn) *
-        (num_this_moves - num_other_moves) /
-        (num_this_moves + num_other_moves);
-
-    // POTENTIAL MOBILITY
-    // There is no need to check whether num_other_spaces + num_this_spaces is
-    // nonzero, since there will only be 0 spaces on the board on the 60th turn.
-    score += (PMOBILITY_MULT_START + PMOBILITY_MULT_CHANGE * turn) *
-    (num_other_spaces - num_this_spaces) /
-    (num_other_spaces + num_this_spaces);
-
-    // CORNERS
-    if (num_this_corners + num_other_corners)
-        score += (CORNERS_MULT_START + CORNERS_MULT_CHANGE * turn) *
-        (num_this_corners - num_other_corners) /
-        (num_this_corners + num_other_corners);
-
-    // POTENTIAL CORNERS
-    if (num_this_corner_moves + num_other_corner_moves)
-        score += (PCORNERS_MULT_START + PCORNERS_MULT_CHANGE * turn) *
-        (num_this_corner_moves - num_other_corner_moves) /
-        (num_this_corner_moves + num_other_corner_moves);
-
-    // SAFETY
-    if (num_this_safe + num_other_safe)
-        score += (SAFETY_MULT_START + SAFETY_MULT_CHANGE * turn) *
-        (num_this_safe - num_other_safe) /
-        (num_this_safe + num_other_safe);
-
-    return score;
+    return evaluate(
+        get_stones(cur_board, side), get_stones(cur_board, !side),
+        cur_board->odd_squares, weights
+        );
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+// Finds the move with the best final disc difference for this player, storing
+// that disc difference in score.
+uint64_t Player::solve_root(int32_t *score)
+{
+    uint64_t best_move = 0,
+    move;
+
+    int32_t alpha = -65,
+    move_score;
+
+    // If this position has been solved before, the move that was played from
+    // it was stored as well, so it can be found without searching.
+    if (
+        solvedb &&
+        solvedb->probe(board->bits[side], board->bits[!side], &alpha)
+        )
+    {
+        for (size_t i = 0; i < movelist->num_moves; i++)
+        {
+            move = get_move(movelist, i);
+            add_stone_copy(board, side, move, get_flips(movelist, i));
+
+            if (
+                solvedb->probe(
+                    (board + 1)->bits[!side], (board + 1)->bits[side],
+                    &move_score
+                    ) &&
+                move_score == -alpha
+                )
+            {
+                *score = alpha;
+                return move;
+            }
+        }
+
+        alpha = -65;
+    }
+
+    alpha = solver->solve(board, side, &best_move);
+    nodes += solver->get_nodes();
+
+    if (stopping.load(memory_order_relaxed))
+        return best_move;
+
+    // The root was searched with a full window, so the scores of the root and
+    // of the best move are exact.
+    uint8_t num_empties =
+    64 - num_ones(board->bits[WHITE] | board->bits[BLACK]);
+    if (solvedb && num_empties <= SOLVEDB_MAX_EMPTIES)
+    {
+        if (num_empties >= SOLVEDB_MIN_EMPTIES)
+            solvedb->store(board->bits[side], board->bits[!side], alpha);
+
+        if (num_empties > SOLVEDB_MIN_EMPTIES)
+        {
+            add_stone_copy(board, side, best_move);
+            solvedb->store(
+                (board + 1)->bits[!side], (board + 1)->bits[side], -alpha
+                );
+        }
+    }
+
+    *score = alpha;
+    return best_move;
 }
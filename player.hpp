@@ -2,22 +2,62 @@
 #define __PLAYER_H__
 
 #include <iostream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <functional>
 #include "common.hpp"
 #include "board.hpp"
+#include "engine.hpp"
+#include "evaluate.hpp"
+#include "gamerecord.hpp"
 using namespace std;
 
-#define MAXDEPTH 7
+// The minimum depth at which a node looks up all of its children in the
+// transposition table before searching any of them.
+#define ETC_MIN_DEPTH 4
 
-#define STONEIMB_MULT_START  1000
-#define STONEIMB_MULT_END    4000
-#define MOBILITY_MULT_START  1200
-#define PMOBILITY_MULT_START 1200
-#define CORNERS_MULT_START   3000
-#define PCORNERS_MULT_START  1800
-#define SAFETY_MULT_START    2400
+// The minimum depth at which a node without moves from the transposition table
+// sorts its moves by the number of replies they leave the other side.
+#define FASTEST_FIRST_MIN_DEPTH 3
 
-// (approximately 537 MB)
-#define MAX_TABLE_SIZE 33554432
+// The most moves in a principal variation reported by a search.
+#define MAX_PV_LENGTH 32
+
+// The number of nodes between checks of the clock by a search with a deadline
+// (a power of two).
+#define DEADLINE_CHECK_NODES 4096
+
+// One of the lines found by a search: the exact score of a move from this
+// side's point of view, and the principal variation that starts with it, as
+// square numbers (8 * y + x), as far as the tables hold it.
+typedef struct pv_line_struct
+{
+    int32_t score;
+    uint8_t pv[MAX_PV_LENGTH];
+    size_t pv_length;
+} *PVLine;
+
+// The result of one iteration of a search started with Player::start_search().
+typedef struct search_info_struct
+{
+    // The depth of the iteration, or the number of empty squares if the
+    // endgame was solved (in which case the scores are final disc
+    // differences).
+    uint8_t depth;
+    bool solved;
+
+    // The best lines, best first: as many as the multipv option asks for (or
+    // as there are legal moves), except that a solved endgame only has one.
+    struct pv_line_struct lines[MAX_MULTIPV];
+    size_t num_lines;
+
+    // The positions searched and the time taken since the search started.
+    uint64_t nodes;
+    uint32_t ms;
+} *SearchInfo;
+
+typedef function<void(const struct search_info_struct &)> SearchCallback;
 
 class Player {
 
@@ -26,24 +66,125 @@ private:
     Board board;
     Movelist movelist;
 
-    struct board_struct board_stack[MAXDEPTH + 2];
-    struct movelist_struct movelist_stack[MAXDEPTH + 1];
+    // The search stacks are sized from the options when the player is
+    // constructed, as is the endgame solver (which has stacks of its own), so
+    // that nothing is allocated while searching.
+    Board board_stack;
+    Movelist movelist_stack;
+    EndgameSolver *solver;
 
+    // The engine's shared resources, copied out of it so that the search never
+    // has to go through the engine to reach them.
+    Engine *engine;
+    bool owns_engine;
     TableEntry table;
     size_t table_size;
+    EntryPool pool;
+    SolvedDB *solvedb;
+    const int32_t (*weights)[NUM_WEIGHTS];
+    const uint8_t (*reductions)[32];
+
+    // Copied from the options, so that the search never has to look them up.
+    uint8_t max_depth, endgame_empties;
+    int move_time_ms, multipv;
+
+    // The number of positions searched so far.
+    uint64_t nodes;
+
+    // The score of the last move found, from this side's point of view.
+    int32_t last_score;
+
+    // The record of the game, or nullptr if it is not being recorded.
+    GameRecord *record;
+
+    // Set to stop the search in progress, which checks it at every node (and
+    // at every node of the endgame solver with enough empty squares left).
+    atomic<bool> stopping;
+
+    // While has_deadline is set, the search sets stopping itself once the
+    // deadline has passed.
+    bool has_deadline;
+    chrono::steady_clock::time_point deadline;
+
+    // The thread running the search started with start_search(), and the
+    // square (or 64 if there is none) and score of the best move from its
+    // last finished iteration, packed into one word so that they are always
+    // read together (see pack_best()).
+    thread search_thread;
+    atomic<uint64_t> best_so_far;
+
+    void init(Side side);
+    template <Side cur_side, bool pv>
+    int32_t search_node(
+        Board cur_board, Movelist cur_movelist, int32_t alpha, int32_t beta,
+        uint8_t depth
+        );
+    void run_search(SearchCallback callback);
+    size_t get_pv(uint64_t move, size_t max_length, uint8_t *pv);
+    Move *unpack_best(uint64_t best, int32_t *score);
+    int time_budget(int msLeft);
+    bool record_move(Move *move, chrono::steady_clock::time_point start);
 
 public:
-    Player(Side side);
+    // Creates a player with its own engine.
+    Player(Side side, const EngineOptions &options = EngineOptions());
+
+    // Creates a player that shares an existing engine with other players. The
+    // engine must outlive the player.
+    Player(Side side, Engine *engine);
+
     ~Player();
 
     Move *doMove(Move *opponentsMove, int msLeft);
+
+    // The same as doMove(), but stores this side's move in move instead of
+    // allocating one, and returns false (leaving move alone) for a pass.
+    // Nothing is allocated, so a wrapper that keeps its moves on the stack
+    // costs no heap traffic per move.
+    bool play_move(Move *opponentsMove, int msLeft, Move *move);
+
+    // Starts searching the current position on another thread, and returns at
+    // once. The search deepens iteratively up to the maximum depth (or solves
+    // the endgame), calling callback on its own thread after every iteration
+    // that it finishes. The player must not be used in any other way until
+    // the search has been stopped or waited for.
+    void start_search(SearchCallback callback);
+
+    // Stops the search (if it is still running), which takes at most a few
+    // microseconds, and returns the best move from its last finished iteration
+    // (or the first legal move, if no iteration finished), storing its score
+    // in score if that is not nullptr. Returns nullptr if there is no legal
+    // move. The move is not played.
+    Move *stop_search(int32_t *score = nullptr);
+
+    // Waits for the search to finish by itself, then returns like
+    // stop_search().
+    Move *wait_search(int32_t *score = nullptr);
+
+    // Returns the best move so far of the search in progress, like
+    // stop_search() but without stopping it. Can be called from any thread.
+    Move *get_best_so_far(int32_t *score = nullptr);
+
+    // Records every move of the game from now on (both sides' moves, and the
+    // time this side takes) in the given record, which must outlive the player.
+    void set_record(GameRecord *record) { this->record = record; }
+
+    uint64_t search_root(uint8_t depth, int32_t *score);
+    size_t search_root_multipv(
+        uint8_t depth, size_t num_lines, uint64_t *best_moves, int32_t *scores
+        );
     int32_t negascout(
         Board cur_board, Movelist cur_movelist, Side cur_side,
         int32_t alpha, int32_t beta, uint8_t depth
         );
     int32_t heuristic(Board board);
 
+    uint64_t solve_root(int32_t *score);
+
+    Side get_side() { return side; }
     Board get_board() { return board; }
+    uint64_t get_nodes() { return nodes; }
+    int32_t get_score() { return last_score; }
 };
 
 #endif
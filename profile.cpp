@@ -0,0 +1,61 @@
+#include "profile.hpp"
+
+#ifdef PROFILE
+
+#include <iomanip>
+
+thread_local ProfileCounters profile_counters = {{0}, {0}, {0}, -1, 0};
+
+static const char *section_names[NUM_PROFILE_SECTIONS] = {
+    "search", "movegen", "ordering", "make move", "hashing", "table",
+    "solvedb", "eval mobility", "eval safety", "eval other",
+    "parity"
+};
+
+static const char *event_names[NUM_PROFILE_EVENTS] = {
+    "all_flips"
+};
+
+void profile_report(ostream &out)
+{
+    // Count the running section's time up to now.
+    profile_charge();
+
+    uint64_t total = 0;
+    for (int i = 0; i < NUM_PROFILE_SECTIONS; i++)
+        total += profile_counters.cycles[i];
+
+    out << "profile: " << fixed << setprecision(1) << total / 1e6 <<
+    " Mcycles" << endl;
+
+    for (int i = 0; i < NUM_PROFILE_SECTIONS; i++)
+    {
+        if (!profile_counters.calls[i])
+            continue;
+
+        out << "  " << left << setw(14) << section_names[i] << right <<
+        setw(12) << profile_counters.calls[i] << " calls" <<
+        setw(10) << setprecision(1) << profile_counters.cycles[i] / 1e6 <<
+        " Mcycles" << setw(12) << setprecision(0) <<
+        (double) profile_counters.cycles[i] / profile_counters.calls[i] <<
+        " per call" << setw(7) << setprecision(1) <<
+        (total ? 100.0 * profile_counters.cycles[i] / total : 0) << "%" <<
+        endl;
+
+        profile_counters.cycles[i] = 0;
+        profile_counters.calls[i] = 0;
+    }
+
+    for (int i = 0; i < NUM_PROFILE_EVENTS; i++)
+    {
+        if (!profile_counters.events[i])
+            continue;
+
+        out << "  " << left << setw(14) << event_names[i] << right <<
+        setw(12) << profile_counters.events[i] << " calls" << endl;
+
+        profile_counters.events[i] = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+/*
+ * When built with PROFILE defined ("make clean && make PROFILE=1"), the main
+ * kernels of the search are timed with the processor's time-stamp counter, and
+ * doMove() prints a breakdown of where its time went to cerr. In a normal
+ * build, all of this compiles away to nothing.
+ *
+ * Each timed scope belongs to a section. Time is charged to the innermost
+ * section that is running, so a section's time excludes the sections nested in
+ * it, and the sections add up to the whole move. The counters are kept per
+ * thread, so every search thread reports only its own moves.
+ */
+
+#ifdef PROFILE
+
+#include <cstdint>
+#include <iostream>
+#include <x86intrin.h>
+using namespace std;
+
+enum ProfileSection {
+    PROFILE_SEARCH,         // anything not in another section
+    PROFILE_MOVEGEN,        // generating the moves to search
+    PROFILE_ORDERING,       // sorting moves
+    PROFILE_MAKE_MOVE,      // placing stones and flipping the others
+    PROFILE_HASHING,        // updating Zobrist hashes
+    PROFILE_TABLE,          // transposition table lookups
+    PROFILE_SOLVEDB,        // solved-position database lookups and stores
+    PROFILE_EVAL_MOBILITY,  // the heuristic's move bitboards
+    PROFILE_EVAL_SAFETY,    // the heuristic's safe stones
+    PROFILE_EVAL_OTHER,     // the rest of the heuristic
+    PROFILE_PARITY,         // finding the regions of empty squares
+    NUM_PROFILE_SECTIONS
+};
+
+// Events that are too frequent and too cheap to be timed, and are only
+// counted.
+enum ProfileEvent {
+    PROFILE_ALL_FLIPS,      // single-stone flip computations
+    NUM_PROFILE_EVENTS
+};
+
+struct ProfileCounters
+{
+    uint64_t cycles[NUM_PROFILE_SECTIONS];
+    uint64_t calls[NUM_PROFILE_SECTIONS];
+    uint64_t events[NUM_PROFILE_EVENTS];
+
+    // The running section (or -1 if none is), and when time was last charged.
+    int current;
+    uint64_t last;
+};
+
+extern thread_local ProfileCounters profile_counters;
+
+// Charges the time since the last charge to the running section.
+static inline uint64_t profile_charge()
+{
+    uint64_t now = __rdtsc();
+
+    if (profile_counters.current >= 0)
+        profile_counters.cycles[profile_counters.current] +=
+        now - profile_counters.last;
+
+    profile_counters.last = now;
+    return now;
+}
+
+class ProfileTimer
+{
+    int outer;
+
+public:
+    ProfileTimer(ProfileSection section)
+    {
+        profile_charge();
+        outer = profile_counters.current;
+        profile_counters.current = section;
+        profile_counters.calls[section]++;
+    }
+
+    ~ProfileTimer()
+    {
+        profile_charge();
+        profile_counters.current = outer;
+    }
+};
+
+// Prints this thread's counters to the given stream, and then clears them.
+void profile_report(ostream &out);
+
+// Times the rest of the enclosing block. A block can contain several timers,
+// in which case each one runs until the end of the block.
+#define PROFILE_NAME(line) profile_timer_ ## line
+#define PROFILE_LINE_NAME(line) PROFILE_NAME(line)
+#define PROFILE_SCOPE(section) \
+    ProfileTimer PROFILE_LINE_NAME(__LINE__)(section)
+#define PROFILE_COUNT(event) (profile_counters.events[event]++)
+#define PROFILE_REPORT(out) profile_report(out)
+
+#else
+
+#define PROFILE_SCOPE(section)
+#define PROFILE_COUNT(event)
+#define PROFILE_REPORT(out)
+
+#endif
+
+#endif
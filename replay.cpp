@@ -0,0 +1,109 @@
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include "gamerecord.hpp"
+using namespace std;
+
+/*
+ * Replays every game in a game record file, checking that each one ends with
+ * the result in its header, and reports how fast the positions were
+ * regenerated. A game whose moves stop before its end (see
+ * GAMERECORD_UNKNOWN_RESULT) is counted as unfinished, whatever result it
+ * claims, since files written before unfinished games were marked gave such
+ * games the disc difference of their last position.
+ *
+ * Usage: replay [--positions] file
+ *
+ * With --positions, every position of every game (including the final one) is
+ * also printed as a line "BOARD SIDE RESULT", where BOARD has one character per
+ * square, row by row from the top left ('b', 'w', or '-' for empty), SIDE is the
+ * side to move ('b' or 'w'), and RESULT is the game's final disc difference for
+ * black. This is the input format for tools that learn from positions, so the
+ * positions of unfinished games are left out.
+ */
+
+// Prints the position as a line of the --positions format.
+static void print_position(GameReplay &replay, int result)
+{
+    char line[64 + 1 + 1 + 1];
+    Board board = replay.get_board();
+
+    for (int i = 0; i < 64; i++)
+        line[i] = ((board->bits[BLACK] >> i) & 1) ? 'b' :
+        ((board->bits[WHITE] >> i) & 1) ? 'w' : '-';
+
+    line[64] = ' ';
+    line[65] = (replay.get_side() == BLACK) ? 'b' : 'w';
+    line[66] = '\0';
+
+    cout << line << " " << result << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    bool print_positions = argc == 3 && !strcmp(argv[1], "--positions");
+
+    if (argc != 2 && !print_positions) {
+        cerr << "usage: " << argv[0] << " [--positions] file" << endl;
+        exit(-1);
+    }
+
+    GameReader reader(argv[argc - 1]);
+    if (!reader.is_open())
+        exit(-1);
+
+    struct game_view_struct game;
+    uint64_t num_games = 0, num_positions = 0, num_mismatches = 0,
+    num_unfinished = 0, num_results[3] = {0, 0, 0};
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    while (reader.next(&game)) {
+        GameReplay replay(&game);
+        int result = game.header->result;
+
+        // The positions of a game are only printed if it was finished, which
+        // takes replaying it to the end first.
+        bool finished = true;
+        if (print_positions) {
+            GameReplay ahead(&game);
+            while (ahead.step())
+                ;
+            finished = game_over(ahead.get_board());
+        }
+
+        do {
+            num_positions++;
+            if (print_positions && finished)
+                print_position(replay, result);
+        } while (replay.step());
+
+        num_games++;
+        finished = game_over(replay.get_board());
+
+        if (
+            replay.next_move() != -1 ||
+            (finished && game_result(replay.get_board()) != result)
+            )
+            num_mismatches++;
+        else if (!finished)
+            num_unfinished++;
+        else
+            num_results[(result > 0) ? 0 : (result < 0) ? 2 : 1]++;
+    }
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start
+        ).count();
+
+    cerr << num_games << " games (" << num_results[0] << " black wins, " <<
+    num_results[1] << " draws, " << num_results[2] << " white wins, " <<
+    num_unfinished << " unfinished), " <<
+    num_positions << " positions in " << seconds << " s (" <<
+    (uint64_t) (num_positions / seconds) << " positions/sec)" << endl;
+
+    if (num_mismatches)
+        cerr << num_mismatches << " games did not replay to their results" <<
+        endl;
+
+    return num_mismatches != 0;
+}
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <string>
+#include "player.hpp"
+using namespace std;
+
+/*
+ * Plays a match between two engine configurations, appending every game to a
+ * game record file as soon as it is finished.
+ *
+ * Usage: selfplay [--option=value ...] games file [config1 config2]
+ *
+ * The options apply to both engines; if two config files are given, each
+ * engine also loads one of them (and is named after it in the records). The
+ * engines take turns playing black. Every game opens with a few random moves,
+ * chosen with the game's number as the seed, so that games differ from each
+ * other but a match can be replayed exactly.
+ */
+
+// The number of random moves that open each game.
+#define SELFPLAY_RANDOM_PLIES 6
+
+// The default size of each engine's table, since there are two of them.
+#define SELFPLAY_HASH_MB 256
+
+int main(int argc, char *argv[]) {
+    EngineOptions options;
+    options.hash_mb = SELFPLAY_HASH_MB;
+    options.solvedb_file = SOLVEDB_FILE;
+
+    int num_positional = options.parse_args(argc - 1, argv + 1);
+    if (num_positional != 2 && num_positional != 4) {
+        cerr << "usage: " << argv[0] <<
+        " [--option=value ...] games file [config1 config2]" << endl;
+        exit(-1);
+    }
+
+    int num_games = atoi(argv[1]);
+
+    EngineOptions engine_options[2] = {options, options};
+    string names[2] = {"denyatbot", "denyatbot"};
+
+    if (num_positional == 4) {
+        for (int i = 0; i < 2; i++) {
+            if (!engine_options[i].load_file(argv[3 + i])) {
+                cerr << "could not load " << argv[3 + i] << endl;
+                exit(-1);
+            }
+            names[i] = argv[3 + i];
+        }
+    }
+
+    GameWriter writer(argv[2]);
+    if (!writer.is_open())
+        exit(-1);
+
+    Engine *engines[2] = {
+        new Engine(engine_options[0]), new Engine(engine_options[1])
+    };
+
+    // Each engine's points: 1 for a win and 1/2 for a draw.
+    double points[2] = {0, 0};
+
+    for (int game = 0; game < num_games; game++) {
+        // The engine that plays each side.
+        int engine_of[2];
+        engine_of[BLACK] = game % 2;
+        engine_of[WHITE] = 1 - game % 2;
+
+        Player *players[2];
+        players[BLACK] = new Player(BLACK, engines[engine_of[BLACK]]);
+        players[WHITE] = new Player(WHITE, engines[engine_of[WHITE]]);
+
+        GameRecord record;
+        record.black_name = names[engine_of[BLACK]];
+        record.white_name = names[engine_of[WHITE]];
+
+        struct board_struct board;
+        set_bits(&board, 0x0000001008000000, 0x0000000810000000);
+        Side side = BLACK;
+
+        mt19937_64 random(game);
+        Move *last_move = nullptr;
+
+        for (int ply = 0; ; ply++) {
+            uint64_t moves = move_bitboard(board.bits[side], board.bits[!side]);
+
+            // Pass, or end the game if neither side can move. The passing
+            // player is still asked for a move, so that it sees the other
+            // side's last move (and returns nullptr).
+            if (!moves) {
+                if (!move_bitboard(board.bits[!side], board.bits[side]))
+                    break;
+
+                if (ply >= SELFPLAY_RANDOM_PLIES)
+                    players[side]->doMove(last_move, -1);
+
+                record.add_move(nullptr);
+                delete last_move;
+                last_move = nullptr;
+                side = !side;
+                continue;
+            }
+
+            Move *move;
+
+            // Play a random opening move on every board, so that neither
+            // player sees it as the other one's move.
+            if (ply < SELFPLAY_RANDOM_PLIES) {
+                for (int i = random() % num_ones(moves); i > 0; i--)
+                    moves &= moves - 1;
+
+                uint8_t position = stone_position(moves & -moves);
+                move = new Move(position % 8, position / 8);
+
+                add_stone(players[BLACK]->get_board(), side, moves & -moves);
+                add_stone(players[WHITE]->get_board(), side, moves & -moves);
+
+                delete last_move;
+                last_move = nullptr;
+            }
+
+            else {
+                chrono::steady_clock::time_point start =
+                chrono::steady_clock::now();
+
+                move = players[side]->doMove(last_move, -1);
+
+                uint32_t ms = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::steady_clock::now() - start
+                    ).count();
+
+                if (side == BLACK)
+                    record.black_ms += ms;
+                else
+                    record.white_ms += ms;
+
+                delete last_move;
+                last_move = move;
+            }
+
+            record.add_move(move);
+            add_stone(&board, side, new_stone(move->x, move->y));
+
+            if (ply < SELFPLAY_RANDOM_PLIES)
+                delete move;
+
+            side = !side;
+        }
+
+        delete last_move;
+        delete players[BLACK];
+        delete players[WHITE];
+
+        if (!writer.write(record))
+            cerr << "could not write game " << game << endl;
+
+        int result = game_result(&board);
+        if (result > 0)
+            points[engine_of[BLACK]] += 1;
+        else if (result < 0)
+            points[engine_of[WHITE]] += 1;
+        else {
+            points[0] += 0.5;
+            points[1] += 0.5;
+        }
+
+        cout << "game " << game << ": " << record.black_name << " (black) " <<
+        ((result > 0) ? "+" : "") << result << " against " <<
+        record.white_name << " (white), " << record.moves.size() <<
+        " moves, " << record.black_ms << "/" << record.white_ms << " ms" <<
+        endl;
+    }
+
+    cout << names[0] << " " << points[0] << ", " << names[1] << " " <<
+    points[1] << endl;
+
+    delete engines[0];
+    delete engines[1];
+    return 0;
+}
@@ -0,0 +1,411 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "player.hpp"
+using namespace std;
+
+/*
+ * A persistent game server: one process that plays any number of concurrent
+ * games, all of which share a single engine (and so a single transposition
+ * table) and a single pool of worker threads.
+ *
+ * Clients talk to the server over stdin/stdout, or, if a socket path is given
+ * on the command line, over any number of connections to a Unix socket. Either
+ * way, the protocol consists of one command per line:
+ *
+ *   new GAME SIDE             Starts a game named GAME (any word without
+ *                             spaces, unique within the connection) in which
+ *                             the server plays SIDE ("Black" or "White").
+ *                             Replies "GAME ok".
+ *   move GAME X Y MSLEFT      Plays the opponent's move (X Y), or a pass (-1
+ *                             -1), and asks for the server's reply, given
+ *                             MSLEFT milliseconds left (-1 for no limit).
+ *                             Replies "GAME X Y", or "GAME -1 -1" for a pass.
+ *   end GAME [X Y]            Ends the game. Replies "GAME ok". If the game
+ *                             ended with the opponent's move, that move can be
+ *                             given as X Y so that it is in the game's record.
+ *   quit                      Closes the connection.
+ *
+ * Moves for different games are searched in parallel, so their replies can
+ * arrive in any order; moves for the same game are searched in the order they
+ * were sent. A malformed command gets the reply "error MESSAGE" (or "GAME error
+ * MESSAGE" if it names a game).
+ *
+ * With --record FILE, every game is appended to the given game record file (see
+ * gamerecord.hpp) once it has ended and its last move has been searched.
+ *
+ * With --memory, the engine's budget only covers the search stacks and endgame
+ * solvers of --threads players, so at most that many games can be in progress
+ * at once; "new" gets the reply "GAME error too many games" beyond that.
+ */
+
+struct Game;
+
+struct Session
+{
+    int in_fd, out_fd;
+    mutex write_lock;
+
+    // The games started on this connection, only used by its reader thread.
+    map<string, shared_ptr<Game> > games;
+
+    Session(int in_fd, int out_fd) : in_fd(in_fd), out_fd(out_fd) {}
+    ~Session() { if (in_fd != STDIN_FILENO) close(in_fd); }
+
+    // Writes a whole line in a single call, so that replies from different
+    // worker threads are never interleaved.
+    void send(const string &line)
+    {
+        string buffer = line + "\n";
+        lock_guard<mutex> guard(write_lock);
+        if (write(out_fd, buffer.c_str(), buffer.size()) < 0)
+            return;
+    }
+};
+
+struct Request
+{
+    int x, y, msLeft;
+};
+
+static GameWriter *writer = nullptr;
+
+// The number of games whose players exist, and the most there can be (0 for no
+// limit).
+static atomic<int> num_games(0);
+static int max_games = 0;
+
+struct Game
+{
+    string name;
+    shared_ptr<Session> session;
+    Player *player;
+
+    // The moves so far, and the opponent's last move if it ended the game.
+    GameRecord record;
+    int last_x, last_y;
+
+    // The moves that have been received but not yet answered. A game is in the
+    // ready queue (scheduled) whenever this is nonempty.
+    mutex lock;
+    deque<Request> pending;
+    bool scheduled;
+
+    Game(const string &name, shared_ptr<Session> session, Player *player) :
+    name(name), session(session), player(player), last_x(-1), last_y(-1),
+    scheduled(false)
+    {
+        if (writer)
+        {
+            record.black_name = (player->get_side() == BLACK) ?
+            "denyatbot" : "opponent";
+            record.white_name = (player->get_side() == WHITE) ?
+            "denyatbot" : "opponent";
+            player->set_record(&record);
+        }
+    }
+
+    ~Game()
+    {
+        if (writer)
+        {
+            if (last_x >= 0 && last_y >= 0)
+            {
+                Move last_move(last_x, last_y);
+                record.add_move(&last_move);
+            }
+
+            writer->write(record);
+        }
+
+        delete player;
+        num_games--;
+    }
+};
+
+static Engine *engine;
+
+// The games with moves waiting to be searched, and whether the workers should
+// exit once it is empty.
+static deque<shared_ptr<Game> > ready;
+static mutex ready_lock;
+static condition_variable ready_signal;
+static bool stopping = false;
+
+static void schedule(shared_ptr<Game> game)
+{
+    lock_guard<mutex> guard(ready_lock);
+    ready.push_back(game);
+    ready_signal.notify_one();
+}
+
+// Searches the oldest pending move of one ready game at a time.
+static void worker()
+{
+    while (true)
+    {
+        shared_ptr<Game> game;
+
+        {
+            unique_lock<mutex> guard(ready_lock);
+            while (ready.empty() && !stopping)
+                ready_signal.wait(guard);
+
+            if (ready.empty())
+                return;
+
+            game = ready.front();
+            ready.pop_front();
+        }
+
+        Request request;
+        {
+            lock_guard<mutex> guard(game->lock);
+            request = game->pending.front();
+        }
+
+        Move opponentsMove(request.x, request.y);
+        Move *playersMove = game->player->doMove(
+            (request.x >= 0 && request.y >= 0) ? &opponentsMove : nullptr,
+            request.msLeft
+            );
+
+        ostringstream reply;
+        reply << game->name << " ";
+        if (playersMove != nullptr)
+            reply << playersMove->x << " " << playersMove->y;
+        else
+            reply << "-1 -1";
+        delete playersMove;
+
+        game->session->send(reply.str());
+
+        lock_guard<mutex> guard(game->lock);
+        game->pending.pop_front();
+
+        if (game->pending.empty())
+            game->scheduled = false;
+        else
+            schedule(game);
+    }
+}
+
+// Carries out a single command from the session, returning false on "quit".
+static bool handle_command(shared_ptr<Session> session, const string &line)
+{
+    istringstream words(line);
+    string command, name;
+    words >> command;
+
+    if (command.empty())
+        return true;
+
+    if (command == "quit")
+        return false;
+
+    if (!(words >> name))
+    {
+        session->send("error expected a game name");
+        return true;
+    }
+
+    map<string, shared_ptr<Game> >::iterator game =
+    session->games.find(name);
+
+    if (command == "new")
+    {
+        string side;
+        if (!(words >> side) || (side != "Black" && side != "White"))
+            session->send(name + " error expected Black or White");
+
+        else if (game != session->games.end())
+            session->send(name + " error game already exists");
+
+        // The game is counted before its player is created, so that two
+        // connections cannot both take the last one.
+        else if (++num_games > max_games && max_games)
+        {
+            num_games--;
+            session->send(name + " error too many games");
+        }
+
+        else
+        {
+            session->games[name] = make_shared<Game>(
+                name, session,
+                new Player((side == "Black") ? BLACK : WHITE, engine)
+                );
+            session->send(name + " ok");
+        }
+    }
+
+    else if (command == "move")
+    {
+        Request request;
+        if (!(words >> request.x >> request.y >> request.msLeft))
+            session->send(name + " error expected X Y MSLEFT");
+
+        else if (game == session->games.end())
+            session->send(name + " error no such game");
+
+        else
+        {
+            lock_guard<mutex> guard(game->second->lock);
+            game->second->pending.push_back(request);
+
+            if (!game->second->scheduled)
+            {
+                game->second->scheduled = true;
+                schedule(game->second);
+            }
+        }
+    }
+
+    else if (command == "end")
+    {
+        if (game == session->games.end())
+            session->send(name + " error no such game");
+
+        // The player is deleted once any move still being searched for it is
+        // finished, when the last reference to the game goes away.
+        else
+        {
+            int x, y;
+            if (words >> x >> y)
+            {
+                game->second->last_x = x;
+                game->second->last_y = y;
+            }
+
+            session->games.erase(game);
+            session->send(name + " ok");
+        }
+    }
+
+    else
+        session->send(name + " error unknown command " + command);
+
+    return true;
+}
+
+// Reads and carries out commands from the session until it is closed.
+static void serve(shared_ptr<Session> session)
+{
+    string buffer;
+    char data[4096];
+    ssize_t length;
+    bool open = true;
+
+    while (open && (length = read(session->in_fd, data, sizeof(data))) > 0)
+    {
+        buffer.append(data, length);
+
+        size_t start = 0, end;
+        while (open && (end = buffer.find('\n', start)) != string::npos)
+        {
+            open = handle_command(session, buffer.substr(start, end - start));
+            start = end + 1;
+        }
+
+        buffer.erase(0, start);
+    }
+
+    session->games.clear();
+}
+
+int main(int argc, char *argv[]) {
+    // Read in engine options, followed by an optional socket path.
+    EngineOptions options;
+    options.solvedb_file = SOLVEDB_FILE;
+    int num_positional = options.parse_args(argc - 1, argv + 1);
+    if (num_positional < 0 || num_positional > 1)  {
+        cerr << "usage: " << argv[0] << " [--option=value ...] [socket]" <<
+        endl;
+        exit(-1);
+    }
+
+    // Replies to clients that have disconnected are simply dropped.
+    signal(SIGPIPE, SIG_IGN);
+
+    engine = new Engine(options);
+
+    // A memory-bounded engine only plans for a player on each thread.
+    if (options.memory_mb > 0)
+        max_games = options.threads;
+
+    if (!options.record_file.empty())
+    {
+        writer = new GameWriter(options.record_file.c_str());
+        if (!writer->is_open())
+            exit(-1);
+    }
+
+    vector<thread> workers;
+    for (int i = 0; i < options.threads; i++)
+        workers.push_back(thread(worker));
+
+    if (num_positional == 0)
+    {
+        shared_ptr<Session> session =
+        make_shared<Session>(STDIN_FILENO, STDOUT_FILENO);
+        session->send("ready");
+        serve(session);
+    }
+
+    else
+    {
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+        unlink(address.sun_path);
+
+        if (
+            listener < 0 ||
+            bind(listener, (struct sockaddr *) &address, sizeof(address)) ||
+            listen(listener, 64)
+            )
+        {
+            cerr << "could not listen on " << argv[1] << endl;
+            exit(-1);
+        }
+
+        cerr << "ready" << endl;
+
+        // Serve every connection on its own reader thread.
+        int connection;
+        while ((connection = accept(listener, nullptr, nullptr)) >= 0)
+            thread(serve, make_shared<Session>(connection, connection)).detach();
+
+        close(listener);
+    }
+
+    // Let the workers finish every move that has already been received.
+    {
+        lock_guard<mutex> guard(ready_lock);
+        stopping = true;
+        ready_signal.notify_all();
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    delete engine;
+    delete writer;
+    return 0;
+}
@@ -0,0 +1,347 @@
+#include "solvedb.hpp"
+#include "board.hpp"
+#include "profile.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Mixes the two halves of a canonical position into a single index hash.
+inline uint64_t record_hash(uint64_t mover, uint64_t opponent)
+{
+    uint64_t hash = mover * 0x9E3779B97F4A7C15 ^ opponent * 0xC2B2AE3D27D4EB4F;
+    return hash ^ (hash >> 29);
+}
+
+// Rounds the size of a database file down to its header and whole records.
+inline size_t whole_records_size(size_t file_size)
+{
+    size_t header_size = sizeof(struct solvedb_header_struct),
+    record_size = sizeof(struct solvedb_record_struct);
+    return header_size + (file_size - header_size) / record_size * record_size;
+}
+
+SolvedDB::SolvedDB(const char *path)
+{
+    mapped = nullptr;
+    mapped_size = num_mapped = num_indexed = 0;
+    num_blocks = num_appended = 0;
+    max_appended = SIZE_MAX;
+    index = nullptr;
+    writable = true;
+
+    fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        cerr << "solvedb: could not open " << path << endl;
+        return;
+    }
+
+    struct stat file_stat;
+    fstat(fd, &file_stat);
+
+    struct solvedb_header_struct header;
+
+    if (file_stat.st_size == 0)
+    {
+        // Start a new database.
+        memset(&header, 0, sizeof(header));
+        strcpy(header.magic, SOLVEDB_MAGIC);
+        header.version = SOLVEDB_VERSION;
+        header.record_size = sizeof(struct solvedb_record_struct);
+
+        if (write(fd, &header, sizeof(header)) != sizeof(header))
+        {
+            cerr << "solvedb: could not write to " << path << endl;
+            close(fd);
+            fd = -1;
+            return;
+        }
+    }
+
+    else
+    {
+        if (
+            pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            memcmp(header.magic, SOLVEDB_MAGIC, sizeof(header.magic)) ||
+            header.version != SOLVEDB_VERSION ||
+            header.record_size != sizeof(struct solvedb_record_struct)
+            )
+        {
+            cerr << "solvedb: " << path << " is not a solved-position database"
+            << endl;
+            close(fd);
+            fd = -1;
+            return;
+        }
+
+        // A partially-written record at the end of the file (left by a
+        // process that was killed mid-append, or by a short write) is cut off,
+        // so that the records appended after it line up again.
+        mapped_size = whole_records_size(file_stat.st_size);
+        if (
+            (size_t) file_stat.st_size > mapped_size &&
+            ftruncate(fd, mapped_size)
+            )
+        {
+            cerr << "solvedb: could not truncate " << path << endl;
+            close(fd);
+            fd = -1;
+            return;
+        }
+
+        void *data = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+
+        if (data == MAP_FAILED)
+        {
+            cerr << "solvedb: could not map " << path << endl;
+            mapped_size = 0;
+        }
+
+        else
+        {
+            mapped = (SolvedDBRecord) ((char *) data + sizeof(header));
+            num_mapped = (mapped_size - sizeof(header)) /
+            sizeof(struct solvedb_record_struct);
+        }
+    }
+
+    size_t index_size = 1024;
+    while (index_size < 2 * num_mapped)
+        index_size *= 2;
+
+    rebuild_index(index_size);
+}
+
+SolvedDB::~SolvedDB()
+{
+    if (mapped)
+        munmap((char *) mapped - sizeof(struct solvedb_header_struct),
+        mapped_size);
+
+    if (fd >= 0)
+        close(fd);
+
+    for (size_t i = 0; i < num_blocks; i++)
+        delete[] blocks[i];
+
+    old_indexes.push_back(index);
+    for (size_t i = 0; i < old_indexes.size(); i++)
+        if (old_indexes[i])
+        {
+            delete[] old_indexes[i]->slots;
+            delete old_indexes[i];
+        }
+}
+
+// Returns the block that holds the given appended record, and the record's
+// place in it. Block k holds SOLVEDB_BLOCK_RECORDS << k records, starting at
+// record SOLVEDB_BLOCK_RECORDS * (2^k - 1).
+static inline size_t block_of(size_t appended_number, size_t *offset)
+{
+    size_t block = 63 - __builtin_clzll(
+        appended_number / SOLVEDB_BLOCK_RECORDS + 1
+        );
+    *offset = appended_number - SOLVEDB_BLOCK_RECORDS * ((1UL << block) - 1);
+    return block;
+}
+
+SolvedDBRecord SolvedDB::get_record(uint32_t number)
+{
+    if (number < num_mapped)
+        return mapped + number;
+
+    size_t offset, block = block_of(number - num_mapped, &offset);
+    return blocks[block] + offset;
+}
+
+void SolvedDB::index_record(SolvedDBIndex into, uint32_t number)
+{
+    SolvedDBRecord record = get_record(number);
+    size_t mask = into->size - 1,
+    slot = record_hash(record->mover, record->opponent) & mask;
+    uint32_t other_number;
+
+    // Use linear probing. A record that was appended more than once (by two
+    // processes sharing the file) keeps its first slot.
+    while ((other_number = into->slots[slot].load(memory_order_relaxed)))
+    {
+        SolvedDBRecord other = get_record(other_number - 1);
+        if (
+            other->mover == record->mover &&
+            other->opponent == record->opponent
+            )
+            return;
+
+        slot = (slot + 1) & mask;
+    }
+
+    // Publish the slot only once the record it refers to has been written.
+    into->slots[slot].store(number + 1, memory_order_release);
+    num_indexed++;
+}
+
+// Builds an index of the given size (a power of two) over every record, and
+// puts it in place of the current one (with the lock held, or before the
+// database is shared).
+void SolvedDB::rebuild_index(size_t size)
+{
+    SolvedDBIndex rebuilt = new struct solvedb_index_struct;
+    rebuilt->size = size;
+    rebuilt->slots = new atomic<uint32_t>[size]();
+    num_indexed = 0;
+
+    for (uint32_t number = 0; number < num_mapped + num_appended; number++)
+        index_record(rebuilt, number);
+
+    SolvedDBIndex replaced = index.exchange(rebuilt, memory_order_acq_rel);
+    if (replaced)
+        old_indexes.push_back(replaced);
+}
+
+size_t SolvedDB::size()
+{
+    lock_guard<mutex> guard(lock);
+    return num_indexed;
+}
+
+bool SolvedDB::probe(uint64_t mover, uint64_t opponent, int32_t *score)
+{
+    PROFILE_SCOPE(PROFILE_SOLVEDB);
+
+    if (fd < 0)
+        return false;
+
+    canonical_bits(&mover, &opponent);
+    return find(mover, opponent, score);
+}
+
+// Looks up a canonical position in the index. A record that is being appended
+// at the same time may or may not be found.
+bool SolvedDB::find(uint64_t mover, uint64_t opponent, int32_t *score)
+{
+    SolvedDBIndex current = index.load(memory_order_acquire);
+    size_t mask = current->size - 1,
+    slot = record_hash(mover, opponent) & mask;
+    uint32_t number;
+
+    while ((number = current->slots[slot].load(memory_order_acquire)))
+    {
+        SolvedDBRecord record = get_record(number - 1);
+        if (record->mover == mover && record->opponent == opponent)
+        {
+            *score = record->score;
+            return true;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    return false;
+}
+
+void SolvedDB::store(uint64_t mover, uint64_t opponent, int32_t score)
+{
+    PROFILE_SCOPE(PROFILE_SOLVEDB);
+
+    if (fd < 0)
+        return;
+
+    canonical_bits(&mover, &opponent);
+
+    lock_guard<mutex> guard(lock);
+
+    int32_t known_score;
+    if (find(mover, opponent, &known_score))
+        return;
+
+    if (!writable || num_appended >= max_appended)
+        return;
+
+    size_t offset, block = block_of(num_appended, &offset);
+    if (block >= SOLVEDB_MAX_BLOCKS)
+        return;
+    if (block == num_blocks)
+        blocks[num_blocks++] =
+        new struct solvedb_record_struct[SOLVEDB_BLOCK_RECORDS << block];
+
+    // The record is written in place before it is indexed, and is not counted
+    // (so its place is reused) unless it also reaches the file.
+    SolvedDBRecord record = blocks[block] + offset;
+    memset(record, 0, sizeof(*record));
+
+    record->mover = mover;
+    record->opponent = opponent;
+    record->score = score;
+    record->empties = 64 - num_ones(mover | opponent);
+
+    // Since the file is opened with O_APPEND, every record is written to the
+    // end of the file in a single call. If only part of it was written (when
+    // the disk is full, say), that part is cut off again, and nothing more is
+    // stored, so that later records cannot be misaligned.
+    ssize_t written = write(fd, record, sizeof(*record));
+    if (written != sizeof(*record))
+    {
+        struct stat file_stat;
+        if (written > 0 && !fstat(fd, &file_stat))
+        {
+            size_t size = whole_records_size(file_stat.st_size);
+            if ((size_t) file_stat.st_size > size && ftruncate(fd, size))
+                cerr << "solvedb: could not truncate a partial record" << endl;
+        }
+
+        writable = false;
+        return;
+    }
+
+    num_appended++;
+
+    SolvedDBIndex current = index.load(memory_order_relaxed);
+    if (2 * (num_indexed + 1) > current->size)
+        rebuild_index(2 * current->size);
+    else
+        index_record(current, num_mapped + num_appended - 1);
+}
+
+void SolvedDB::reserve(size_t num_records)
+{
+    lock_guard<mutex> guard(lock);
+
+    max_appended = num_appended + num_records;
+
+    // Allocate every block that the records can go in.
+    while (
+        num_blocks < SOLVEDB_MAX_BLOCKS &&
+        SOLVEDB_BLOCK_RECORDS * ((1UL << num_blocks) - 1) < max_appended
+        )
+    {
+        blocks[num_blocks] =
+        new struct solvedb_record_struct[SOLVEDB_BLOCK_RECORDS << num_blocks];
+        num_blocks++;
+    }
+
+    // Keep the index at most half full even once every record is stored.
+    size_t size = index.load(memory_order_relaxed)->size;
+    if (size < 2 * (num_mapped + max_appended))
+    {
+        while (size < 2 * (num_mapped + max_appended))
+            size *= 2;
+        rebuild_index(size);
+    }
+}
+
+size_t SolvedDB::memory_bytes()
+{
+    lock_guard<mutex> guard(lock);
+
+    size_t bytes = mapped_size +
+    index.load(memory_order_relaxed)->size * sizeof(atomic<uint32_t>) +
+    SOLVEDB_BLOCK_RECORDS * ((1UL << num_blocks) - 1) *
+    sizeof(struct solvedb_record_struct);
+
+    for (size_t i = 0; i < old_indexes.size(); i++)
+        bytes += old_indexes[i]->size * sizeof(atomic<uint32_t>);
+
+    return bytes;
+}
@@ -0,0 +1,134 @@
+#ifndef __SOLVEDB_H__
+#define __SOLVEDB_H__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+/*
+ * The solved-position database is a persistent store of exact endgame scores.
+ * It lives in a single append-only file which begins with a small header and
+ * is followed by fixed-size records, each containing a canonical position
+ * (see canonical_bits()) and its final disc difference for the side to move:
+ *
+ * +--------+---------+-------------+----------+----------+-----
+ * | magic  | version | record_size | record 0 | record 1 | ...
+ * +--------+---------+-------------+----------+----------+-----
+ *
+ * The file is mmap-ed when the database is opened, and an in-memory hash index
+ * is built over the mapped records. Positions solved afterwards are appended to
+ * the end of the file and added to the index, so they can be looked up
+ * immediately and are still available the next time the file is opened. A
+ * partial record at the end of the file (left by a process that died while
+ * appending it) is truncated away when the file is opened.
+ *
+ * The endgame solver's threads all probe the database at 10-20 empty squares,
+ * so probes take no lock: records never move once written, and a slot of the
+ * index is filled in only after its record is. Only appending takes the lock.
+ */
+
+#define SOLVEDB_MAGIC   "OTHSDB1"
+#define SOLVEDB_VERSION 1
+
+// Only positions with at most this many empty squares are stored.
+#define SOLVEDB_MAX_EMPTIES 20
+
+// Positions with fewer than this many empty squares are quicker to solve than
+// to look up, so they are neither probed nor stored.
+#define SOLVEDB_MIN_EMPTIES 10
+
+typedef struct solvedb_header_struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} *SolvedDBHeader;
+
+typedef struct solvedb_record_struct
+{
+    uint64_t mover, opponent;
+    int8_t score;
+    uint8_t empties;
+    uint8_t padding[6];
+} *SolvedDBRecord;
+
+// An open-addressing hash table of record numbers plus one (0 marks an empty
+// slot), where numbers past the mapped records refer to appended ones. Slots
+// are only ever filled in, so a reader needs no lock: a slot it sees filled
+// refers to a record that was written before it.
+typedef struct solvedb_index_struct
+{
+    size_t size;
+    atomic<uint32_t> *slots;
+} *SolvedDBIndex;
+
+// The number of records in the first block of appended records. Each block
+// after it holds twice as many as the one before, so that records never move
+// once they are appended.
+#define SOLVEDB_BLOCK_RECORDS 1024UL
+#define SOLVEDB_MAX_BLOCKS    32
+
+class SolvedDB {
+
+private:
+    int fd;
+
+    // The records that were in the file when it was opened.
+    SolvedDBRecord mapped;
+    size_t mapped_size, num_mapped;
+
+    // The records that have been appended since the file was opened, in
+    // blocks that are allocated as they are needed, and the most that can be
+    // appended (once reserve() has been called).
+    SolvedDBRecord blocks[SOLVEDB_MAX_BLOCKS];
+    size_t num_blocks, num_appended, max_appended;
+
+    // Cleared once a record could not be written in full, after which nothing
+    // more is stored.
+    bool writable;
+
+    // The index, which is replaced by a larger one as it fills up, and the
+    // indexes it replaced, which are kept until the database is closed in case
+    // a reader is still using them.
+    atomic<SolvedDBIndex> index;
+    vector<SolvedDBIndex> old_indexes;
+    size_t num_indexed;
+
+    // Held while records are appended, so that the database can be shared by
+    // several threads. Probes never take it.
+    mutex lock;
+
+    SolvedDBRecord get_record(uint32_t number);
+    bool find(uint64_t mover, uint64_t opponent, int32_t *score);
+    void index_record(SolvedDBIndex into, uint32_t number);
+    void rebuild_index(size_t size);
+
+public:
+    SolvedDB(const char *path);
+    ~SolvedDB();
+
+    bool is_open() { return fd >= 0; }
+
+    // The number of distinct positions in the database.
+    size_t size();
+
+    // Looks up the exact score of the position for the side to move, returning
+    // false if the position has not been solved.
+    bool probe(uint64_t mover, uint64_t opponent, int32_t *score);
+
+    // Records the exact score of the position for the side to move.
+    void store(uint64_t mover, uint64_t opponent, int32_t score);
+
+    // Allocates room for the given number of records to be stored, after which
+    // storing more records is a no-op, so that the database never allocates
+    // memory again.
+    void reserve(size_t num_records);
+
+    // The number of bytes of memory that the database maps or allocates.
+    size_t memory_bytes();
+};
+
+#endif
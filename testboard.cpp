@@ -0,0 +1,411 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include "board.hpp"
+
+// Use this file to check the bitboard kernels (moves, flips, empty squares next
+// to a side's stones, safe stones, and odd regions) against simple references
+// that look at one square at a time, over random positions and over positions
+// built to catch stones wrapping around the board's edges. It also compares
+// the throughputs of the kernels and the references, so that a faster kernel
+// can be swapped in with confidence.
+//
+// Built with -DFUZZ (see "make fuzzboard"), it is a libFuzzer target instead,
+// which reads each input as a pair of bitboards.
+
+static const int directions[8][2] = {
+    {1, 0}, {-1, 1}, {0, 1}, {1, 1}, {-1, 0}, {1, -1}, {0, -1}, {-1, -1}
+};
+
+static inline bool on_board(int x, int y)
+{
+    return x >= 0 && x < 8 && y >= 0 && y < 8;
+}
+
+static inline uint64_t square(int x, int y)
+{
+    return 1ULL << (8 * y + x);
+}
+
+// The stones flipped by this side playing on the empty square (x, y).
+static uint64_t reference_flips(
+    uint64_t this_side, uint64_t other_side, int x, int y
+    )
+{
+    uint64_t flips = 0;
+
+    for (int d = 0; d < 8; d++)
+    {
+        uint64_t line = 0;
+        int i = x + directions[d][0], j = y + directions[d][1];
+
+        while (on_board(i, j) && (other_side & square(i, j)))
+        {
+            line |= square(i, j);
+            i += directions[d][0];
+            j += directions[d][1];
+        }
+
+        if (line && on_board(i, j) && (this_side & square(i, j)))
+            flips |= line;
+    }
+
+    return flips;
+}
+
+static uint64_t reference_moves(uint64_t this_side, uint64_t other_side)
+{
+    uint64_t moves = 0;
+
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++)
+            if (
+                !((this_side | other_side) & square(x, y)) &&
+                reference_flips(this_side, other_side, x, y)
+                )
+                moves |= square(x, y);
+
+    return moves;
+}
+
+static uint8_t reference_spaces(uint64_t this_side, uint64_t other_side)
+{
+    uint8_t num_spaces = 0;
+
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++)
+        {
+            if ((this_side | other_side) & square(x, y))
+                continue;
+
+            for (int d = 0; d < 8; d++)
+            {
+                int i = x + directions[d][0], j = y + directions[d][1];
+
+                if (on_board(i, j) && (this_side & square(i, j)))
+                {
+                    num_spaces++;
+                    break;
+                }
+            }
+        }
+
+    return num_spaces;
+}
+
+// This side's stones that none of the other side's moves would flip.
+static uint8_t reference_safe(uint64_t this_side, uint64_t other_side)
+{
+    uint64_t flippable = 0;
+
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 8; x++)
+            if (!((this_side | other_side) & square(x, y)))
+                flippable |= reference_flips(other_side, this_side, x, y);
+
+    return num_ones(this_side & ~flippable);
+}
+
+static uint64_t reference_odd_regions(uint64_t empty_spaces)
+{
+    if (num_ones(empty_spaces) > PARITY_MAX_EMPTIES)
+        return 0;
+
+    uint64_t odd_squares = 0, seen = 0;
+
+    for (int start = 0; start < 64; start++)
+    {
+        if (!(empty_spaces & ~seen & (1ULL << start)))
+            continue;
+
+        // Flood-fill the region with a stack of squares.
+        int stack[64], size = 0;
+        uint64_t region = 1ULL << start;
+        stack[size++] = start;
+
+        while (size)
+        {
+            int x = stack[size - 1] % 8, y = stack[size - 1] / 8;
+            size--;
+
+            for (int d = 0; d < 8; d++)
+            {
+                int i = x + directions[d][0], j = y + directions[d][1];
+
+                if (
+                    on_board(i, j) && (empty_spaces & square(i, j)) &&
+                    !(region & square(i, j))
+                    )
+                {
+                    region |= square(i, j);
+                    stack[size++] = 8 * j + i;
+                }
+            }
+        }
+
+        seen |= region;
+        if (num_ones(region) & 1)
+            odd_squares |= region;
+    }
+
+    return odd_squares;
+}
+
+// Checks every kernel on the position, with each side to move, and returns the
+// number of results that differ from the references.
+static int check_position(uint64_t blacks, uint64_t whites)
+{
+    // The kernels assume that no square holds two stones.
+    whites &= ~blacks;
+
+    uint64_t sides[2] = {whites, blacks};
+    const char *kernels[5] = {"moves", "flips", "spaces", "safe", "parity"};
+    int failed[5] = {0, 0, 0, 0, 0};
+
+    for (int side = 0; side < 2; side++)
+    {
+        uint64_t this_side = sides[side], other_side = sides[!side];
+
+        if (
+            move_bitboard(this_side, other_side) !=
+            reference_moves(this_side, other_side)
+            )
+            failed[0]++;
+
+        for (int y = 0; y < 8; y++)
+            for (int x = 0; x < 8; x++)
+                if (
+                    !((this_side | other_side) & square(x, y)) &&
+                    flip_bitboard(this_side, other_side, square(x, y)) !=
+                    reference_flips(this_side, other_side, x, y)
+                    )
+                    failed[1]++;
+
+        if (
+            num_spaces(this_side, other_side) !=
+            reference_spaces(this_side, other_side)
+            )
+            failed[2]++;
+
+        if (
+            num_safe(this_side, other_side) !=
+            reference_safe(this_side, other_side)
+            )
+            failed[3]++;
+    }
+
+    uint64_t empty_spaces = ~(whites | blacks);
+    if (odd_regions(empty_spaces) != reference_odd_regions(empty_spaces))
+        failed[4]++;
+
+    int num_failed = 0;
+
+    for (int k = 0; k < 5; k++)
+        if (failed[k])
+        {
+            std::cerr << kernels[k] << " differs for black 0x" << std::hex <<
+            blacks << ", white 0x" << whites << std::dec << std::endl;
+            num_failed++;
+        }
+
+    if (num_failed)
+    {
+        struct board_struct board;
+        set_bits(&board, whites, blacks);
+        print_board(&board);
+    }
+
+    return num_failed;
+}
+
+
+// <--------------------------------------------------------------------------->
+
+
+#ifdef FUZZ
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (size < 16)
+        return 0;
+
+    uint64_t blacks = 0, whites = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        blacks |= (uint64_t) data[i] << (8 * i);
+        whites |= (uint64_t) data[8 + i] << (8 * i);
+    }
+
+    if (check_position(blacks, whites))
+        abort();
+
+    return 0;
+}
+
+#else
+
+// Returns a random bitboard in which each bit is set with probability
+// numerator / 8.
+static uint64_t random_bits(std::mt19937_64 &random, int numerator)
+{
+    uint64_t bits = 0;
+
+    for (int i = 0; i < 64; i++)
+        if ((int) (random() % 8) < numerator)
+            bits |= 1ULL << i;
+
+    return bits;
+}
+
+int main(int argc, char *argv[]) {
+    std::mt19937_64 random(2016);
+
+    // Pairs of {black stones, white stones}.
+    std::vector<uint64_t> positions;
+
+    // Every arrangement of stones along each row, column, and long diagonal,
+    // with the rest of the board empty.
+    for (int line = 0; line < 18; line++)
+    {
+        int x, y, dx, dy;
+        if (line < 8)
+            x = 0, y = line, dx = 1, dy = 0;
+        else if (line < 16)
+            x = line - 8, y = 0, dx = 0, dy = 1;
+        else if (line == 16)
+            x = 0, y = 0, dx = 1, dy = 1;
+        else
+            x = 7, y = 0, dx = -1, dy = 1;
+
+        for (int pattern = 0; pattern < 6561; pattern++)
+        {
+            uint64_t blacks = 0, whites = 0;
+
+            for (int i = 0, digits = pattern; i < 8; i++, digits /= 3)
+            {
+                if (digits % 3 == 1)
+                    blacks |= square(x + i * dx, y + i * dy);
+                else if (digits % 3 == 2)
+                    whites |= square(x + i * dx, y + i * dy);
+            }
+
+            positions.push_back(blacks);
+            positions.push_back(whites);
+        }
+    }
+
+    // Stones only on the two columns at each edge, where shifts wrap around.
+    const uint64_t edge_columns = 0xC3C3C3C3C3C3C3C3;
+    for (int i = 0; i < 100000; i++)
+    {
+        uint64_t occupied = random_bits(random, 1 + i % 7) & edge_columns,
+        blacks = occupied & random();
+
+        positions.push_back(blacks);
+        positions.push_back(occupied & ~blacks);
+    }
+
+    // Random boards from nearly empty to nearly full, including boards with
+    // only a few empty squares (where every region is small).
+    for (int i = 0; i < 200000; i++)
+    {
+        uint64_t occupied = random_bits(random, 1 + i % 7);
+        if (i % 8 == 7)
+            occupied = ~random_bits(random, 1);
+
+        uint64_t blacks = occupied & random();
+
+        positions.push_back(blacks);
+        positions.push_back(occupied & ~blacks);
+    }
+
+    size_t num_positions = positions.size() / 2, num_failed = 0;
+
+    for (size_t i = 0; i < num_positions; i++)
+        if (check_position(positions[2 * i], positions[2 * i + 1]))
+            num_failed++;
+
+    std::cout << num_positions << " positions, " << num_failed <<
+    " mismatches" << std::endl;
+
+    // Compare the throughputs of the kernels and the references, taking the
+    // best of several runs. Each position counts once per side to move.
+    const char *names[5] = {"moves", "flips", "spaces", "safe", "parity"};
+    double kernel_best[5] = {0, 0, 0, 0, 0},
+    reference_best[5] = {0, 0, 0, 0, 0};
+    volatile uint64_t sink = 0;
+
+    for (int run = 0; run < 3; run++)
+        for (int kernel = 0; kernel < 5; kernel++)
+            for (int reference = 0; reference < 2; reference++)
+            {
+                std::chrono::steady_clock::time_point start =
+                std::chrono::steady_clock::now();
+
+                uint64_t result = 0;
+
+                for (size_t i = 0; i < 2 * num_positions; i++)
+                {
+                    uint64_t this_side = positions[i],
+                    other_side = positions[i ^ 1],
+                    // The first empty square, for the flips.
+                    empty = ~(this_side | other_side) &
+                    -~(this_side | other_side);
+
+                    switch (kernel) {
+                    case 0:
+                        result += reference ?
+                        reference_moves(this_side, other_side) :
+                        move_bitboard(this_side, other_side);
+                        break;
+                    case 1:
+                        if (!empty)
+                            break;
+                        result += reference ?
+                        reference_flips(
+                            this_side, other_side, stone_position(empty) % 8,
+                            stone_position(empty) / 8
+                            ) :
+                        flip_bitboard(this_side, other_side, empty);
+                        break;
+                    case 2:
+                        result += reference ?
+                        reference_spaces(this_side, other_side) :
+                        num_spaces(this_side, other_side);
+                        break;
+                    case 3:
+                        result += reference ?
+                        reference_safe(this_side, other_side) :
+                        num_safe(this_side, other_side);
+                        break;
+                    case 4:
+                        result += reference ?
+                        reference_odd_regions(~(this_side | other_side)) :
+                        odd_regions(~(this_side | other_side));
+                        break;
+                    }
+                }
+
+                sink = sink + result;
+
+                double rate = 2 * num_positions / std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start
+                    ).count();
+
+                double &best =
+                reference ? reference_best[kernel] : kernel_best[kernel];
+                if (rate > best)
+                    best = rate;
+            }
+
+    for (int kernel = 0; kernel < 5; kernel++)
+        std::cout << names[kernel] << ": " << (uint64_t) kernel_best[kernel] <<
+        " positions/sec (reference " << (uint64_t) reference_best[kernel] <<
+        ")" << std::endl;
+
+    return num_failed != 0;
+}
+
+#endif
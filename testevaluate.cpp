@@ -0,0 +1,184 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include "board.hpp"
+#include "engine.hpp"
+#include "evaluate.hpp"
+
+// Use this file to check that the batch version of the heuristic gives exactly
+// the same scores as the scalar version, and to compare their throughputs. It
+// also checks that the heuristic is antisymmetric (the search relies on it),
+// and that the odd regions kept up to date move by move match the ones found
+// from scratch, and compares the costs of the two.
+int main(int argc, char *argv[]) {
+    // Only the heuristic's weights are needed, so keep the table small.
+    EngineOptions options;
+    options.hash_mb = 1;
+    options.solvedb_file = "";
+    Engine *engine = new Engine(options);
+
+    // Collect the positions from random games, scored for both sides.
+    std::mt19937_64 random(2016);
+    std::vector<uint64_t> positions;
+
+    // Every move of the games, as {odd-region squares, empty squares, move}
+    // before the move is played, and the number of positions whose updated
+    // odd regions differ from the ones found from scratch.
+    std::vector<uint64_t> updates;
+    size_t parity_mismatches = 0;
+
+    while (positions.size() < 2 * 200000) {
+        struct board_struct board;
+        set_bits(&board, 0x0000001008000000, 0x0000000810000000);
+        Side side = BLACK;
+        bool passed = false;
+
+        while (true) {
+            uint64_t this_stones = get_stones(&board, side),
+            other_stones = get_stones(&board, !side);
+
+            positions.push_back(this_stones);
+            positions.push_back(other_stones);
+
+            uint64_t moves = move_bitboard(this_stones, other_stones);
+            if (!moves) {
+                if (passed)
+                    break;
+                passed = true;
+                side = (Side) !side;
+                continue;
+            }
+            passed = false;
+
+            for (int i = random() % num_ones(moves); i > 0; i--)
+                moves &= moves - 1;
+
+            updates.push_back(board.odd_squares);
+            updates.push_back(~(this_stones | other_stones));
+            updates.push_back(moves & -moves);
+
+            add_stone(&board, side, moves & -moves);
+            side = (Side) !side;
+
+            if (
+                board.odd_squares !=
+                odd_regions(~(board.bits[WHITE] | board.bits[BLACK]))
+                )
+                parity_mismatches++;
+        }
+    }
+
+    const uint64_t (*pairs)[2] = (const uint64_t (*)[2]) positions.data();
+    size_t num_positions = positions.size() / 2;
+    std::vector<int32_t> scalar_scores(num_positions),
+    batch_scores(num_positions);
+
+    // Compare the scores.
+    for (size_t i = 0; i < num_positions; i++)
+        scalar_scores[i] = evaluate(pairs[i][0], pairs[i][1], engine->weights);
+    evaluate_batch(pairs, num_positions, engine->weights, batch_scores.data());
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_positions; i++)
+        if (scalar_scores[i] != batch_scores[i])
+            mismatches++;
+
+    std::cout << num_positions << " positions, " << mismatches <<
+    " mismatches" << std::endl;
+
+    // The search scores leaves for the side to move, which relies on the
+    // heuristic being antisymmetric.
+    size_t asymmetric = 0;
+    for (size_t i = 0; i < num_positions; i++)
+        if (
+            scalar_scores[i] !=
+            -evaluate(pairs[i][1], pairs[i][0], engine->weights)
+            )
+            asymmetric++;
+
+    std::cout << asymmetric << " positions not antisymmetric" << std::endl;
+
+    size_t num_updates = updates.size() / 3;
+    std::cout << num_updates << " moves, " << parity_mismatches <<
+    " parity mismatches" << std::endl;
+
+    // Compare the costs of finding the odd regions after each move from
+    // scratch and from the ones before the move.
+    double scratch_best = 1e30, update_best = 1e30;
+    volatile uint64_t odd_sink = 0;
+
+    for (int run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < updates.size(); i += 3)
+            odd_sink = odd_sink ^ odd_regions(updates[i + 1] & ~updates[i + 2]);
+
+        std::chrono::steady_clock::time_point middle =
+        std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < updates.size(); i += 3)
+            odd_sink = odd_sink ^
+            odd_regions_after(updates[i], updates[i + 1], updates[i + 2]);
+
+        std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now();
+
+        double scratch_ns = 1e9 *
+        std::chrono::duration<double>(middle - start).count() / num_updates,
+        update_ns = 1e9 *
+        std::chrono::duration<double>(end - middle).count() / num_updates;
+
+        if (scratch_ns < scratch_best)
+            scratch_best = scratch_ns;
+        if (update_ns < update_best)
+            update_best = update_ns;
+    }
+
+    std::cout << "parity from scratch: " << scratch_best << " ns/move" <<
+    std::endl << "parity updated:      " << update_best << " ns/move" <<
+    std::endl;
+
+    // Compare the throughputs, taking the best of several runs.
+    double scalar_best = 0, batch_best = 0;
+    volatile int32_t sink = 0;
+
+    for (int run = 0; run < 5; run++) {
+        std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < num_positions; i++)
+            scalar_scores[i] =
+            evaluate(pairs[i][0], pairs[i][1], engine->weights);
+        sink = sink + scalar_scores[num_positions - 1];
+
+        std::chrono::steady_clock::time_point middle =
+        std::chrono::steady_clock::now();
+
+        evaluate_batch(
+            pairs, num_positions, engine->weights, batch_scores.data()
+            );
+        sink = sink + batch_scores[num_positions - 1];
+
+        std::chrono::steady_clock::time_point end =
+        std::chrono::steady_clock::now();
+
+        double scalar_rate = num_positions /
+        std::chrono::duration<double>(middle - start).count(),
+        batch_rate = num_positions /
+        std::chrono::duration<double>(end - middle).count();
+
+        if (scalar_rate > scalar_best)
+            scalar_best = scalar_rate;
+        if (batch_rate > batch_best)
+            batch_best = batch_rate;
+    }
+
+    std::cout << "scalar: " << (uint64_t) scalar_best << " positions/sec" <<
+    std::endl << "batch:  " << (uint64_t) batch_best << " positions/sec" <<
+    std::endl;
+
+    delete engine;
+    return mismatches != 0 || parity_mismatches != 0 || asymmetric != 0;
+}
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "engine.hpp"
+
+// The budgets tried, in MB, and the smallest one that must be enough for the
+// smallest tables.
+#define MAX_TEST_MB 64
+#define MIN_FEASIBLE_MB 8
+
+// Use this file to check that a memory-bounded engine never plans to use more
+// than its budget, over a range of small budgets (where the tables' rounding to
+// huge pages matters most), and that a budget too small for even the smallest
+// tables makes the engine exit rather than run over it. Each engine is built in
+// a child process, since such an engine exits.
+int main(int argc, char *argv[]) {
+    size_t num_failed = 0;
+
+    for (size_t memory_mb = 1; memory_mb <= MAX_TEST_MB; memory_mb++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cout << "could not fork" << std::endl;
+            return 1;
+        }
+
+        if (pid == 0) {
+            EngineOptions options;
+            options.memory_mb = memory_mb;
+            options.solvedb_file = "";
+
+            // Keep the output to what goes wrong.
+            if (!freopen("/dev/null", "w", stderr))
+                _exit(1);
+
+            Engine *engine = new Engine(options);
+            _exit(engine->planned_bytes <= (memory_mb << 20) ? 0 : 2);
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+        // A budget too small for the smallest tables exits with status 255.
+        if (code == 0 || (code == 255 && memory_mb < MIN_FEASIBLE_MB))
+            continue;
+
+        if (code == 2)
+            std::cout << memory_mb << " MB: planned past the budget" <<
+            std::endl;
+        else
+            std::cout << memory_mb << " MB: engine failed (status " << code <<
+            ")" << std::endl;
+        num_failed++;
+    }
+
+    std::cout << num_failed << " budgets failed" << std::endl;
+    return num_failed != 0;
+}
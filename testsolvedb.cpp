@@ -0,0 +1,205 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.hpp"
+#include "solvedb.hpp"
+
+#define TEST_FILE "testsolvedb.sdb"
+
+// A position with 10-20 empty squares from a random game, and a made-up score.
+struct TestPosition
+{
+    uint64_t mover, opponent;
+    int32_t score;
+};
+
+static bool check_positions(
+    SolvedDB &db, const std::vector<TestPosition> &positions, const char *when
+    )
+{
+    size_t num_failed = 0;
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        int32_t score;
+        if (
+            !db.probe(positions[i].mover, positions[i].opponent, &score) ||
+            score != positions[i].score
+            )
+            num_failed++;
+    }
+
+    if (num_failed)
+        std::cout << when << ": " << num_failed << " of " << positions.size() <<
+        " positions missing or wrong" << std::endl;
+
+    return num_failed == 0;
+}
+
+// The number of threads that store and probe the same database at once.
+#define TEST_THREADS 4
+
+// Stores every TEST_THREADS-th position (starting at the thread's own), probing
+// every position after each store, and counts the probes that find a wrong
+// score. (A probe may miss a position that another thread has not stored yet.)
+static void store_and_probe(
+    SolvedDB *db, const std::vector<TestPosition> *positions, size_t first,
+    std::atomic<size_t> *num_wrong
+    )
+{
+    for (size_t i = first; i < positions->size(); i += TEST_THREADS) {
+        db->store((*positions)[i].mover, (*positions)[i].opponent,
+            (*positions)[i].score);
+
+        for (size_t k = 0; k < positions->size(); k += 7) {
+            int32_t score;
+            if (
+                db->probe((*positions)[k].mover, (*positions)[k].opponent,
+                    &score) &&
+                score != (*positions)[k].score
+                )
+                (*num_wrong)++;
+        }
+    }
+}
+
+// Use this file to check that the solved-position database keeps its records
+// across reopening, that a partial record left at the end of the file (by a
+// process killed mid-append) is cut off, rather than misaligning the records
+// appended after it, and that threads probing the database while others store
+// into it (and grow its index) never find a wrong score.
+int main(int argc, char *argv[]) {
+    std::mt19937_64 random(2016);
+    std::vector<TestPosition> positions;
+
+    // Collect distinct positions from random games.
+    while (positions.size() < 2000) {
+        struct board_struct board;
+        set_bits(&board, 0x0000001008000000, 0x0000000810000000);
+        Side side = BLACK;
+
+        while (true) {
+            uint64_t moves =
+            move_bitboard(get_stones(&board, side), get_stones(&board, !side));
+            if (!moves)
+                break;
+
+            for (int i = random() % num_ones(moves); i > 0; i--)
+                moves &= moves - 1;
+            add_stone(&board, side, moves & -moves);
+            side = !side;
+
+            uint64_t mover = get_stones(&board, side),
+            opponent = get_stones(&board, !side);
+            int empties = 64 - num_ones(mover | opponent);
+            if (empties < SOLVEDB_MIN_EMPTIES || empties > SOLVEDB_MAX_EMPTIES)
+                continue;
+
+            bool seen = false;
+            for (size_t i = 0; i < positions.size() && !seen; i++) {
+                uint64_t a = positions[i].mover, b = positions[i].opponent,
+                c = mover, d = opponent;
+                canonical_bits(&a, &b);
+                canonical_bits(&c, &d);
+                seen = (a == c && b == d);
+            }
+            if (seen)
+                continue;
+
+            int32_t score = (int32_t) (random() % 129) - 64;
+            positions.push_back(TestPosition{mover, opponent, score});
+        }
+    }
+
+    std::vector<TestPosition> first(positions.begin(), positions.begin() + 1000),
+    second(positions.begin() + 1000, positions.end());
+    bool ok = true;
+
+    remove(TEST_FILE);
+
+    {
+        SolvedDB db(TEST_FILE);
+        for (size_t i = 0; i < first.size(); i++)
+            db.store(first[i].mover, first[i].opponent, first[i].score);
+        ok = check_positions(db, first, "after storing") && ok;
+    }
+
+    // Append a torn record, as a process killed mid-append would leave it.
+    {
+        char partial[sizeof(struct solvedb_record_struct) / 2];
+        for (size_t i = 0; i < sizeof(partial); i++)
+            partial[i] = (char) random();
+
+        int fd = open(TEST_FILE, O_WRONLY | O_APPEND);
+        if (fd < 0 || write(fd, partial, sizeof(partial)) != sizeof(partial)) {
+            std::cout << "could not append to " << TEST_FILE << std::endl;
+            return 1;
+        }
+        close(fd);
+    }
+
+    // Reopening has to cut the partial record off, so that the records stored
+    // next line up.
+    {
+        SolvedDB db(TEST_FILE);
+        ok = check_positions(db, first, "after reopening a torn file") && ok;
+
+        struct stat file_stat;
+        stat(TEST_FILE, &file_stat);
+        if (
+            (file_stat.st_size - sizeof(struct solvedb_header_struct)) %
+            sizeof(struct solvedb_record_struct)
+            ) {
+            std::cout << "partial record was not truncated" << std::endl;
+            ok = false;
+        }
+
+        for (size_t i = 0; i < second.size(); i++)
+            db.store(second[i].mover, second[i].opponent, second[i].score);
+    }
+
+    {
+        SolvedDB db(TEST_FILE);
+        ok = check_positions(db, positions, "after appending past the tear") &&
+        ok;
+        if (db.size() != positions.size()) {
+            std::cout << db.size() << " records indexed, expected " <<
+            positions.size() << std::endl;
+            ok = false;
+        }
+    }
+
+    remove(TEST_FILE);
+
+    // Store from several threads at once, without taking a lock to probe.
+    {
+        SolvedDB db(TEST_FILE);
+        std::atomic<size_t> num_wrong(0);
+        std::vector<std::thread> threads;
+
+        for (size_t t = 0; t < TEST_THREADS; t++)
+            threads.push_back(std::thread(
+                store_and_probe, &db, &positions, t, &num_wrong
+                ));
+        for (size_t t = 0; t < TEST_THREADS; t++)
+            threads[t].join();
+
+        if (num_wrong) {
+            std::cout << num_wrong << " concurrent probes found wrong scores" <<
+            std::endl;
+            ok = false;
+        }
+        ok = check_positions(db, positions, "after storing from threads") &&
+        ok;
+    }
+
+    remove(TEST_FILE);
+
+    std::cout << (ok ? "solvedb: ok" : "solvedb: FAILED") << std::endl;
+    return !ok;
+}
@@ -0,0 +1,82 @@
+#include "trace.hpp"
+
+#ifdef SEARCH_TRACE
+
+#include <cstdio>
+#include <cstring>
+
+// Each thread's ring buffer, and the total number of records added to it since
+// it was last cleared (the next record goes at num_records % TRACE_CAPACITY).
+static thread_local TraceRecord trace_records = nullptr;
+static thread_local uint64_t trace_num_records = 0;
+
+void trace_start()
+{
+    if (!trace_records)
+        trace_records = new struct trace_record_struct[TRACE_CAPACITY];
+
+    trace_num_records = 0;
+}
+
+int32_t trace_node(
+    uint64_t hash, uint8_t ply, uint8_t depth, int32_t alpha, int32_t beta,
+    int32_t score, uint8_t best_index, uint8_t num_moves, TraceKind kind
+    )
+{
+    if (!trace_records)
+        return score;
+
+    TraceRecord record =
+    &trace_records[trace_num_records++ % TRACE_CAPACITY];
+
+    record->hash = hash;
+    record->alpha = alpha;
+    record->beta = beta;
+    record->score = score;
+    record->depth = depth;
+    record->ply = ply;
+    record->best_index = best_index;
+    record->num_moves = num_moves;
+    record->kind = kind;
+
+    return score;
+}
+
+bool trace_dump(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    struct trace_file_header_struct header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, TRACE_MAGIC);
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(struct trace_record_struct);
+
+    header.num_records = trace_num_records < TRACE_CAPACITY ?
+    trace_num_records : TRACE_CAPACITY;
+    header.num_dropped = trace_num_records - header.num_records;
+
+    // Once the buffer has wrapped around, the oldest record is the one that
+    // would be overwritten next.
+    size_t first = header.num_dropped ? trace_num_records % TRACE_CAPACITY : 0,
+    num_after = TRACE_CAPACITY - first;
+    if (num_after > header.num_records)
+        num_after = header.num_records;
+
+    bool ok =
+    fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(
+        trace_records + first, sizeof(struct trace_record_struct), num_after,
+        file
+        ) == num_after &&
+    fwrite(
+        trace_records, sizeof(struct trace_record_struct),
+        header.num_records - num_after, file
+        ) == header.num_records - num_after;
+
+    return fclose(file) == 0 && ok;
+}
+
+#endif
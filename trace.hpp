@@ -0,0 +1,116 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * When built with SEARCH_TRACE defined ("make clean && make SEARCH_TRACE=1"),
+ * every node of the midgame search (and the root of every iteration) is
+ * recorded in a ring buffer as it returns, and doMove() writes the buffer out
+ * to TRACE_FILE, replacing the trace of the move before. "traceview" turns
+ * the file into a summary, a DOT graph, or JSON. In a normal build, all of this
+ * compiles away to nothing.
+ *
+ * A trace file is a small header followed by the records, oldest first:
+ *
+ * +-------+---------+-------------+-------------+-------------+----------+-----
+ * | magic | version | record_size | num_records | num_dropped | record 0 | ...
+ * +-------+---------+-------------+-------------+-------------+----------+-----
+ *
+ * Since a node is recorded after its children, the records are in post-order,
+ * and the tree can be rebuilt from their plies alone: the parent of a node is
+ * the next node recorded at a ply one less. Once the buffer is full, the
+ * oldest records are dropped (and counted in num_dropped), so the nodes at the
+ * start of the trace may be missing their parents' earlier children.
+ */
+
+#define TRACE_MAGIC   "OTHTRC1"
+#define TRACE_VERSION 1
+#define TRACE_FILE    "search.trace"
+
+// The number of records kept in each thread's ring buffer (32 MB of them).
+#define TRACE_CAPACITY (1 << 20)
+
+// How a node got its score.
+enum TraceKind {
+    TRACE_SEARCHED,     // by searching its moves
+    TRACE_LEAF,         // from the heuristic, at depth 0
+    TRACE_TABLE,        // from its transposition table entry
+    TRACE_ETC,          // from a child's entry (enhanced transposition cutoff)
+    TRACE_NO_MOVES,     // from the heuristic, since the side to move must pass
+    TRACE_ROOT          // by searching the moves of the root
+};
+
+// The index (in search order) of the best move, when no move raised alpha.
+#define TRACE_NO_MOVE 0xFF
+
+typedef struct trace_file_header_struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t num_records, num_dropped;
+} *TraceFileHeader;
+
+typedef struct trace_record_struct
+{
+    uint64_t hash;
+
+    // The window that the node was searched with, and the score it returned.
+    int32_t alpha, beta, score;
+
+    // The remaining depth, and the distance from the root.
+    uint8_t depth, ply;
+
+    // The index of the move that raised alpha last (so of the move that cut
+    // off, if the score is at least beta), or TRACE_NO_MOVE, and the number of
+    // moves.
+    uint8_t best_index, num_moves;
+
+    // A TraceKind.
+    uint8_t kind;
+
+    uint8_t padding[7];
+} *TraceRecord;
+
+#ifdef SEARCH_TRACE
+
+// Clears this thread's trace, allocating its buffer the first time.
+void trace_start();
+
+// Adds a record to this thread's trace and returns the score, so that it can
+// wrap a return value.
+int32_t trace_node(
+    uint64_t hash, uint8_t ply, uint8_t depth, int32_t alpha, int32_t beta,
+    int32_t score, uint8_t best_index, uint8_t num_moves, TraceKind kind
+    );
+
+// Writes this thread's trace to the given file, returning false if it cannot.
+bool trace_dump(const char *path);
+
+// TRACE_ENTER() goes at the top of a traced function, before alpha changes;
+// TRACE_BEST(i) notes the index of a move that raised alpha; and
+// TRACE_RETURN(...) wraps each value that the function returns.
+#define TRACE_ENTER(alpha) \
+    int32_t trace_alpha = (alpha); uint8_t trace_best = TRACE_NO_MOVE
+#define TRACE_BEST(index) (trace_best = (index))
+#define TRACE_RETURN(hash, ply, depth, beta, score, num_moves, kind) \
+    trace_node( \
+        hash, ply, depth, trace_alpha, beta, score, trace_best, num_moves, \
+        kind \
+        )
+#define TRACE_START() trace_start()
+#define TRACE_DUMP(path) trace_dump(path)
+
+#else
+
+#define TRACE_ENTER(alpha)
+#define TRACE_BEST(index)
+#define TRACE_RETURN(hash, ply, depth, beta, score, num_moves, kind) (score)
+#define TRACE_START()
+#define TRACE_DUMP(path)
+
+#endif
+
+#endif
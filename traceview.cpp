@@ -0,0 +1,289 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include "trace.hpp"
+using namespace std;
+
+/*
+ * Reads a search trace (see trace.hpp) and prints a summary of it, or converts
+ * it to a DOT graph or to JSON.
+ *
+ * Usage: traceview [--dot | --json] [--max-ply N] file
+ *
+ * The summary shows how the nodes got their scores, how often the move that
+ * cut off a node was the first one searched (and if not, how late it came),
+ * and how many nodes went into re-searches: a child searched again right after
+ * itself, after its empty-window (or reduced) search failed high. The DOT
+ * graph and the JSON list every node up to the given ply (all of them, by
+ * default) along with its parent, window, score, and best move; in the graph,
+ * nodes that cut off are red, nodes that failed low are gray, and re-searches
+ * are drawn with dashed edges.
+ */
+
+static const char *kind_names[] = {
+    "searched", "leaf", "table", "etc", "no_moves", "root"
+};
+#define NUM_KINDS (sizeof(kind_names) / sizeof(kind_names[0]))
+
+// What is rebuilt of a node from the records.
+struct TraceNode
+{
+    // The index of the parent's record (-1 if it is a root, or missing), and
+    // the index of the node among its parent's children.
+    int64_t parent;
+    uint32_t child_index;
+
+    // The number of records in the node's subtree, including the node.
+    uint64_t subtree_size;
+
+    // Set if the previous child of the same parent was the same position.
+    bool research;
+};
+
+// Rebuilds the tree from the records, which are in post-order: the children of
+// each node are the nodes one ply deeper recorded right before it that do not
+// have parents yet.
+static void build_tree(
+    const vector<struct trace_record_struct> &records, vector<TraceNode> &nodes
+    )
+{
+    nodes.assign(records.size(), TraceNode{-1, 0, 1, false});
+    vector<size_t> pending;
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        size_t first = pending.size();
+        while (
+            first > 0 && records[pending[first - 1]].ply == records[i].ply + 1
+            )
+            first--;
+
+        for (size_t k = first; k < pending.size(); k++)
+        {
+            size_t child = pending[k];
+            nodes[child].parent = i;
+            nodes[child].child_index = k - first;
+            nodes[child].research =
+            k > first && records[pending[k - 1]].hash == records[child].hash;
+            nodes[i].subtree_size += nodes[child].subtree_size;
+        }
+
+        pending.resize(first);
+        pending.push_back(i);
+    }
+}
+
+static void print_summary(
+    const struct trace_file_header_struct &header,
+    const vector<struct trace_record_struct> &records,
+    const vector<TraceNode> &nodes
+    )
+{
+    uint64_t kinds[NUM_KINDS] = {0}, cutoffs = 0, cutoff_at[4] = {0},
+    researches = 0, research_nodes = 0, full_window = 0;
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const struct trace_record_struct &record = records[i];
+
+        if (record.kind < NUM_KINDS)
+            kinds[record.kind]++;
+
+        if (record.kind == TRACE_SEARCHED || record.kind == TRACE_ROOT)
+        {
+            if ((int64_t) record.beta - record.alpha > 1)
+                full_window++;
+
+            if (record.score >= record.beta && record.best_index != TRACE_NO_MOVE)
+            {
+                cutoffs++;
+                cutoff_at[record.best_index < 3 ? record.best_index : 3]++;
+            }
+        }
+
+        if (nodes[i].research)
+        {
+            researches++;
+            research_nodes += nodes[i].subtree_size;
+        }
+    }
+
+    cout << records.size() << " nodes";
+    if (header.num_dropped)
+        cout << " (and " << header.num_dropped << " older ones dropped)";
+    cout << endl;
+
+    for (size_t k = 0; k < NUM_KINDS; k++)
+        if (kinds[k])
+            cout << "  " << left << setw(10) << kind_names[k] << right <<
+            setw(12) << kinds[k] << endl;
+
+    cout << fixed << setprecision(1);
+    cout << "searched with a full window: " << full_window << endl;
+
+    cout << "cutoffs: " << cutoffs;
+    if (cutoffs)
+        cout << " (first move " << 100.0 * cutoff_at[0] / cutoffs <<
+        "%, second " << 100.0 * cutoff_at[1] / cutoffs << "%, third " <<
+        100.0 * cutoff_at[2] / cutoffs << "%, later " <<
+        100.0 * cutoff_at[3] / cutoffs << "%)";
+    cout << endl;
+
+    cout << "re-searches: " << researches << ", costing " << research_nodes <<
+    " nodes (" << (records.empty() ? 0 : 100.0 * research_nodes /
+    records.size()) << "%)" << endl;
+}
+
+static void print_dot(
+    const vector<struct trace_record_struct> &records,
+    const vector<TraceNode> &nodes, int max_ply
+    )
+{
+    cout << "digraph search {" << endl <<
+    "  node [shape=box, fontname=\"monospace\", fontsize=10];" << endl;
+
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const struct trace_record_struct &record = records[i];
+        if (record.ply > max_ply)
+            continue;
+
+        const char *color = (record.score >= record.beta) ? "red" :
+        (record.score <= record.alpha) ? "gray" : "black";
+
+        cout << "  n" << i << " [color=" << color << ", label=\"" <<
+        kind_names[record.kind < NUM_KINDS ? record.kind : 0] << " ply " <<
+        (int) record.ply << " depth " << (int) record.depth << "\\n[" <<
+        record.alpha << ", " << record.beta << "] -> " << record.score;
+
+        if (record.best_index != TRACE_NO_MOVE)
+            cout << "\\nbest " << (int) record.best_index << " of " <<
+            (int) record.num_moves;
+
+        cout << "\\n" << nodes[i].subtree_size << " nodes\"];" << endl;
+
+        if (nodes[i].parent >= 0)
+            cout << "  n" << nodes[i].parent << " -> n" << i << " [label=\"" <<
+            nodes[i].child_index << "\"" <<
+            (nodes[i].research ? ", style=dashed" : "") << "];" << endl;
+    }
+
+    cout << "}" << endl;
+}
+
+static void print_json(
+    const struct trace_file_header_struct &header,
+    const vector<struct trace_record_struct> &records,
+    const vector<TraceNode> &nodes, int max_ply
+    )
+{
+    cout << "{\"dropped\": " << header.num_dropped << ", \"nodes\": [";
+
+    bool first = true;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const struct trace_record_struct &record = records[i];
+        if (record.ply > max_ply)
+            continue;
+
+        cout << (first ? "\n" : ",\n") << "{\"id\": " << i << ", \"parent\": " <<
+        nodes[i].parent << ", \"child\": " << nodes[i].child_index <<
+        ", \"hash\": \"" << hex << setw(16) << setfill('0') << record.hash <<
+        dec << setfill(' ') << "\", \"kind\": \"" <<
+        kind_names[record.kind < NUM_KINDS ? record.kind : 0] <<
+        "\", \"ply\": " << (int) record.ply << ", \"depth\": " <<
+        (int) record.depth << ", \"alpha\": " << record.alpha <<
+        ", \"beta\": " << record.beta << ", \"score\": " << record.score <<
+        ", \"best\": " << (record.best_index == TRACE_NO_MOVE ? -1 :
+        (int) record.best_index) << ", \"moves\": " <<
+        (int) record.num_moves << ", \"research\": " <<
+        (nodes[i].research ? "true" : "false") << ", \"size\": " <<
+        nodes[i].subtree_size << "}";
+
+        first = false;
+    }
+
+    cout << "\n]}" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    bool dot = false, json = false;
+    int max_ply = 255;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--dot"))
+            dot = true;
+        else if (!strcmp(argv[i], "--json"))
+            json = true;
+        else if (!strcmp(argv[i], "--max-ply") && i + 1 < argc)
+            max_ply = atoi(argv[++i]);
+        else if (!path && argv[i][0] != '-')
+            path = argv[i];
+        else
+            path = nullptr, i = argc;
+    }
+
+    if (!path || (dot && json))
+    {
+        cerr << "usage: " << argv[0] << " [--dot | --json] [--max-ply N] file" <<
+        endl;
+        exit(-1);
+    }
+
+    ifstream file(path, ios::binary | ios::ate);
+    uint64_t file_size = file ? (uint64_t) file.tellg() : 0;
+    file.seekg(0);
+
+    struct trace_file_header_struct header;
+
+    if (
+        !file.read((char *) &header, sizeof(header)) ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) ||
+        header.version != TRACE_VERSION ||
+        header.record_size != sizeof(struct trace_record_struct)
+        )
+    {
+        cerr << "traceview: " << path << " is not a search trace" << endl;
+        exit(-1);
+    }
+
+    // Check the number of records against the file before making room for
+    // them, since it comes from the file.
+    if (
+        header.num_records >
+        (file_size - sizeof(header)) / sizeof(struct trace_record_struct)
+        )
+    {
+        cerr << "traceview: " << path << " is truncated" << endl;
+        exit(-1);
+    }
+
+    vector<struct trace_record_struct> records(header.num_records);
+    if (
+        !file.read(
+            (char *) records.data(),
+            header.num_records * sizeof(struct trace_record_struct)
+            )
+        )
+    {
+        cerr << "traceview: " << path << " is truncated" << endl;
+        exit(-1);
+    }
+
+    vector<TraceNode> nodes;
+    build_tree(records, nodes);
+
+    if (dot)
+        print_dot(records, nodes, max_ply);
+    else if (json)
+        print_json(header, records, nodes, max_ply);
+    else
+        print_summary(header, records, nodes);
+
+    return 0;
+}
@@ -1,46 +1,143 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
+#include <unistd.h>
 #include "player.hpp"
 using namespace std;
 
+/*
+ * The protocol with the java wrapper is one line per turn each way: it sends
+ * the opponent's move and the time left ("x y msLeft", with -1 -1 for a pass
+ * or for black's first move), and gets back this side's move ("x y", or -1 -1
+ * for a pass). Every line is answered before the next one is sent, so the time
+ * spent reading and writing lines is added to every move.
+ *
+ * To keep that time down, the lines are read straight from the pipe into a
+ * buffer and parsed by hand, and each answer is written with a single write(),
+ * bypassing iostreams (and their locking and syncing with stdio) entirely.
+ * Moves are kept on the stack, so nothing is allocated per move.
+ */
+
+// The standard input, read into a buffer as it arrives.
+static char input[4096];
+static size_t input_start = 0, input_end = 0;
+
+// Returns the next character of the standard input, or -1 at its end.
+static inline int next_char()
+{
+    if (input_start == input_end)
+    {
+        ssize_t length;
+        do
+            length = read(STDIN_FILENO, input, sizeof(input));
+        while (length < 0 && errno == EINTR);
+
+        if (length <= 0)
+            return -1;
+
+        input_start = 0;
+        input_end = length;
+    }
+
+    return input[input_start++];
+}
+
+// Reads the next integer (possibly negative) from the standard input, skipping
+// any whitespace before it. Returns false at the end of the input, or if
+// something other than an integer comes next.
+static bool read_int(int *value)
+{
+    int c = next_char();
+    while (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+        c = next_char();
+
+    bool negative = (c == '-');
+    if (negative)
+        c = next_char();
+
+    if (c < '0' || c > '9')
+        return false;
+
+    int number = 0;
+    for (; c >= '0' && c <= '9'; c = next_char())
+        number = 10 * number + (c - '0');
+
+    *value = negative ? -number : number;
+    return true;
+}
+
+// Writes the whole buffer to the standard output.
+static void write_all(const char *buffer, size_t length)
+{
+    while (length)
+    {
+        ssize_t written = write(STDOUT_FILENO, buffer, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return;
+
+        buffer += written;
+        length -= written;
+    }
+}
+
 int main(int argc, char *argv[]) {
-    // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
+    // Read in engine options, followed by the side the player is on.
+    EngineOptions options;
+    if (options.parse_args(argc - 1, argv + 1) != 1)  {
+        cerr << "usage: " << argv[0] << " [--option=value ...] side" << endl;
         exit(-1);
     }
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
 
     // Initialize player.
-    Player *player = new Player(side);
+    Player *player = new Player(side, options);
+
+    // Record the game if a record file was given. The opponent's engine is
+    // unknown, and so is its time.
+    GameRecord record;
+    if (!options.record_file.empty()) {
+        record.black_name = (side == BLACK) ? "denyatbot" : "opponent";
+        record.white_name = (side == WHITE) ? "denyatbot" : "opponent";
+        player->set_record(&record);
+    }
 
     // Tell java wrapper that we are done initializing.
-    cout << "Init done" << endl;
-    cout.flush();
+    write_all("Init done\n", 10);
 
     int moveX, moveY, msLeft;
+    Move opponentsMove(-1, -1), playersMove(-1, -1);
 
     // Get opponent's move and time left for player each turn.
-    while (cin >> moveX >> moveY >> msLeft) {
-        Move *opponentsMove = nullptr;
-        if (moveX >= 0 && moveY >= 0) {
-            opponentsMove = new Move(moveX, moveY);
-        }
+    while (read_int(&moveX) && read_int(&moveY) && read_int(&msLeft)) {
+        opponentsMove.x = moveX;
+        opponentsMove.y = moveY;
 
-        // Get player's move and output to java wrapper.
-        Move *playersMove = player->doMove(opponentsMove, msLeft);
-        if (playersMove != nullptr) {
-            cout << playersMove->x << " " << playersMove->y << endl;
+        // Get player's move and output to java wrapper. Squares are single
+        // digits, so the answer is "x y\n" or "-1 -1\n".
+        if (
+            player->play_move(
+                (moveX >= 0 && moveY >= 0) ? &opponentsMove : nullptr, msLeft,
+                &playersMove
+                )
+            ) {
+            char answer[4] = {
+                (char) ('0' + playersMove.x), ' ', (char) ('0' + playersMove.y),
+                '\n'
+            };
+            write_all(answer, sizeof(answer));
         } else {
-            cout << "-1 -1" << endl;
+            write_all("-1 -1\n", 6);
         }
-        cout.flush();
-        cerr.flush();
+    }
 
-        // Delete move objects.
-        if (opponentsMove != nullptr) delete opponentsMove;
-        if (playersMove != nullptr) delete playersMove;
+    // The game is over once the opponent stops sending moves. (If the
+    // opponent's move ended the game, it was never sent, and is not recorded.)
+    if (!options.record_file.empty()) {
+        GameWriter writer(options.record_file.c_str());
+        writer.write(record);
     }
 
     return 0;